@@ -0,0 +1,97 @@
+#include "autotune.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+namespace {
+
+constexpr int kWarmupSteps = 2;
+constexpr int kSignatureGrid = 16;
+
+double medianStepMs(const std::string& method, const EngineParams& params, const std::vector<Particle>& particles,
+                    float box_w, float box_h, float r, float dt, int trialSteps) {
+    std::vector<Particle> trial = particles;
+    std::unique_ptr<Engine> engine = makeEngine(method, box_w, box_h, r, params);
+    for (int i = 0; i < kWarmupSteps; ++i) {
+        engine->step(trial, dt);
+    }
+    std::vector<double> ms;
+    for (int i = 0; i < trialSteps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        engine->step(trial, dt);
+        ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(ms.begin(), ms.end());
+    return ms[ms.size() / 2];
+}
+
+}
+
+std::vector<EngineParams> autotuneCandidates(const std::string& method, int N, const EngineParams& base) {
+    std::vector<EngineParams> grid;
+    if (method == "quadtree") {
+        for (int cap : {4, 8, 16, 32}) {
+            for (int depth : {8, 10, 12}) {
+                EngineParams p = base;
+                p.quadtreeCap = cap;
+                p.quadtreeMaxDepth = depth;
+                grid.push_back(p);
+            }
+        }
+    } else if (method == "hash") {
+        for (float scale : {2.0f, 3.0f, 4.0f}) {
+            for (float load : {0.75f, 0.5f, 0.25f}) {
+                // Default table, and one big enough that N occupied cells never resize it
+                int presized = 256;
+                while (presized * load < N) presized *= 2;
+                std::vector<int> tables = {256};
+                if (presized > 256) tables.push_back(presized);
+                for (int table : tables) {
+                    EngineParams p = base;
+                    p.hashCellScale = scale;
+                    p.hashMaxLoad = load;
+                    p.hashTableSize = table;
+                    grid.push_back(p);
+                }
+            }
+        }
+    }
+    return grid;
+}
+
+AutotuneResult autotune(const std::string& method, const std::vector<Particle>& particles,
+                        float box_w, float box_h, float r, float dt, int trialSteps, const EngineParams& base) {
+    AutotuneResult result;
+    result.params = base;
+    std::vector<EngineParams> grid = autotuneCandidates(method, static_cast<int>(particles.size()), base);
+    if (grid.empty()) {
+        return result;
+    }
+    trialSteps = std::max(trialSteps, 1);
+    result.defaultMs = medianStepMs(method, base, particles, box_w, box_h, r, dt, trialSteps);
+    result.bestMs = result.defaultMs;
+    for (const EngineParams& params : grid) {
+        double ms = medianStepMs(method, params, particles, box_w, box_h, r, dt, trialSteps);
+        result.trials++;
+        if (ms < result.bestMs) {
+            result.bestMs = ms;
+            result.params = params;
+        }
+    }
+    return result;
+}
+
+double clusteringSignature(const std::vector<Particle>& particles, float box_w, float box_h) {
+    if (particles.empty()) return 0.0;
+    std::vector<int> counts(kSignatureGrid * kSignatureGrid, 0);
+    for (const auto& p : particles) {
+        int i = std::min(std::max(static_cast<int>(p.x / box_w * kSignatureGrid), 0), kSignatureGrid - 1);
+        int j = std::min(std::max(static_cast<int>(p.y / box_h * kSignatureGrid), 0), kSignatureGrid - 1);
+        counts[j * kSignatureGrid + i]++;
+    }
+    double mean = static_cast<double>(particles.size()) / counts.size();
+    double sq = 0.0;
+    for (int c : counts) sq += (c - mean) * (c - mean);
+    return std::sqrt(sq / counts.size()) / mean;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "engine.hpp"
+#include "particle.hpp"
+#include <string>
+#include <vector>
+
+// Startup tuning of broad-phase parameters (--autotune)
+//
+// Each candidate setting gets a fresh engine stepping a copy of the
+// particles: two untimed steps to build up the structures, then trialSteps
+// timed ones. The setting with the lowest median step time wins. The real
+// particles are never touched.
+
+struct AutotuneResult {
+    EngineParams params;       // Fastest setting
+    double bestMs = 0.0;       // Its median step time
+    double defaultMs = 0.0;    // Median step time of the base parameters
+    int trials = 0;            // Settings tried
+};
+
+// Parameter grid for an engine, as variations of `base` (whose other fields,
+// e.g. ccd, carry over); empty if the engine has nothing to tune, in which
+// case autotune() returns `base` without timing anything
+std::vector<EngineParams> autotuneCandidates(const std::string& method, int N,
+                                             const EngineParams& base = EngineParams());
+
+AutotuneResult autotune(const std::string& method, const std::vector<Particle>& particles,
+                        float box_w, float box_h, float r, float dt, int trialSteps,
+                        const EngineParams& base = EngineParams());
+
+// Coefficient of variation of particle counts over a 16x16 grid of the box:
+// about 1/sqrt(N/256) for a uniform gas, larger when particles cluster.
+// --autotune_every re-tunes when it moves by more than a quarter.
+double clusteringSignature(const std::vector<Particle>& particles, float box_w, float box_h);
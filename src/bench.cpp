@@ -0,0 +1,771 @@
+// particle-box-bench: microbenchmarks of the broad-phase structures, the
+// physics kernels and full engine steps, without the init and output costs
+// that end-to-end runs of particle-box mix in.
+//
+// Every case runs on a workload of N particles placed by the simulator's own
+// initializer in a square box sized for the requested area fraction. A case
+// is warmed up, then timed for a number of repetitions; each repetition runs
+// the operation once per particle (or per candidate pair) and is reported as
+// nanoseconds per operation. Setup between repetitions (restoring particle
+// state) is not timed.
+//
+// With --save_baseline or --compare it runs the regression gate instead: a
+// fixed scenario suite stepped by every engine, compared step by step
+// against a stored baseline (see runGate).
+
+#include "init.hpp"
+#include "engine.hpp"
+#include "engine_brute.hpp"
+#include "quadtree.hpp"
+#include "spatial_hash.hpp"
+#include "physics.hpp"
+#include "csv.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+struct BenchOptions {
+    std::vector<int> Ns = {1000, 4000, 16000};
+    std::vector<double> densities = {0.05, 0.2};     // Area fraction N*pi*r^2 / box area
+    std::vector<std::string> radii = {"fixed", "mixed"};
+    float radius = 3.0f;
+    float dt = 0.002f;
+    int warmup = 3;
+    int reps = 15;
+    uint64_t seed = 1337;
+    std::string filter;                               // Substring of the case name
+    std::string csv;
+    std::string json;
+    // Regression gate
+    std::string saveBaseline;
+    std::string compare;
+    std::string diffCsv;
+    int suiteRuns = 5;
+    int suiteSteps = 200;
+    double alpha = 0.01;                              // One-sided Mann-Whitney significance
+    double threshold = 0.05;                          // Smallest median change reported
+};
+
+struct Workload {
+    int N;
+    double density;
+    std::string radii;         // "fixed": all r; "mixed": uniform in [r/2, r]
+    float side;
+    float maxRadius;
+    std::vector<Particle> particles;
+};
+
+struct Result {
+    std::string name;
+    const Workload* workload;
+    uint64_t opsPerRep;
+    std::vector<double> nsPerOp;  // One sample per repetition
+    double min, median, mean, stddev, max;
+};
+
+// Keeps results the compiler could otherwise prove unused
+volatile uint64_t sink = 0;
+
+void printUsage(const char* progname) {
+    std::cout << "Usage: " << progname << " [options]\n"
+              << "Options:\n"
+              << "  --N <list>              Particle counts (default: 1000,4000,16000)\n"
+              << "  --density <list>        Area fractions covered by particles (default: 0.05,0.2)\n"
+              << "  --radii <list>          Radius distributions, fixed and/or mixed (default: fixed,mixed)\n"
+              << "  --radius <float>        Particle radius; mixed draws from [r/2, r] (default: 3.0)\n"
+              << "  --dt <float>            Timestep for the integrate and step cases (default: 0.002)\n"
+              << "  --warmup <int>          Untimed runs before each case (default: 3)\n"
+              << "  --reps <int>            Timed repetitions per case (default: 15)\n"
+              << "  --seed <uint64>         RNG seed (default: 1337)\n"
+              << "  --filter <string>       Only run cases whose name contains this\n"
+              << "  --csv <file>            Write one row per case and workload\n"
+              << "  --json <file>           Write results with per-repetition samples\n"
+              << "Regression gate:\n"
+              << "  --save_baseline <file>  Run the scenario suite and store every step time\n"
+              << "  --compare <file>        Run the suite and compare against a stored baseline;\n"
+              << "                          exits with status 2 on a significant regression\n"
+              << "  --suite_runs <int>      Independent runs per scenario and engine (default: 5)\n"
+              << "  --suite_steps <int>     Timed steps per run (default: 200)\n"
+              << "  --alpha <float>         One-sided Mann-Whitney significance level (default: 0.01)\n"
+              << "  --threshold <float>     Median slowdown that counts as a regression (default: 0.05)\n"
+              << "  --diff_csv <file>       Also write the comparison table as CSV\n"
+              << "  --help, -h              Show this help\n";
+}
+
+std::vector<std::string> splitList(const std::string& s) {
+    std::vector<std::string> result;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) result.push_back(item);
+    }
+    return result;
+}
+
+BenchOptions parseOptions(int argc, char* argv[]) {
+    BenchOptions opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--N" && hasValue) {
+            opts.Ns.clear();
+            for (const auto& s : splitList(argv[++i])) opts.Ns.push_back(std::stoi(s));
+        } else if (arg == "--density" && hasValue) {
+            opts.densities.clear();
+            for (const auto& s : splitList(argv[++i])) opts.densities.push_back(std::stod(s));
+        } else if (arg == "--radii" && hasValue) {
+            opts.radii = splitList(argv[++i]);
+        } else if (arg == "--radius" && hasValue) {
+            opts.radius = std::stof(argv[++i]);
+        } else if (arg == "--dt" && hasValue) {
+            opts.dt = std::stof(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            opts.warmup = std::stoi(argv[++i]);
+        } else if (arg == "--reps" && hasValue) {
+            opts.reps = std::stoi(argv[++i]);
+        } else if (arg == "--seed" && hasValue) {
+            opts.seed = std::stoull(argv[++i]);
+        } else if (arg == "--filter" && hasValue) {
+            opts.filter = argv[++i];
+        } else if (arg == "--csv" && hasValue) {
+            opts.csv = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            opts.json = argv[++i];
+        } else if (arg == "--save_baseline" && hasValue) {
+            opts.saveBaseline = argv[++i];
+        } else if (arg == "--compare" && hasValue) {
+            opts.compare = argv[++i];
+        } else if (arg == "--diff_csv" && hasValue) {
+            opts.diffCsv = argv[++i];
+        } else if (arg == "--suite_runs" && hasValue) {
+            opts.suiteRuns = std::stoi(argv[++i]);
+        } else if (arg == "--suite_steps" && hasValue) {
+            opts.suiteSteps = std::stoi(argv[++i]);
+        } else if (arg == "--alpha" && hasValue) {
+            opts.alpha = std::stod(argv[++i]);
+        } else if (arg == "--threshold" && hasValue) {
+            opts.threshold = std::stod(argv[++i]);
+        } else if (arg == "--help" || arg == "-h") {
+            printUsage(argv[0]);
+            std::exit(0);
+        } else {
+            std::cerr << "Error: Unknown or incomplete option " << arg << std::endl;
+            std::exit(1);
+        }
+    }
+    return opts;
+}
+
+Workload makeWorkload(int N, double density, const std::string& radii, const BenchOptions& opts) {
+    Workload w;
+    w.N = N;
+    w.density = density;
+    w.radii = radii;
+    w.maxRadius = opts.radius;
+    w.side = static_cast<float>(std::sqrt(N * M_PI * opts.radius * opts.radius / density));
+
+    SimConfig config;
+    config.N = N;
+    config.radius = opts.radius;
+    config.box_w = w.side;
+    config.box_h = w.side;
+    RNG rng(opts.seed);
+    w.particles = initializeParticles(config, rng);
+
+    // Shrinking radii after placement keeps the particles non-overlapping
+    if (radii == "mixed") {
+        RNG radiusRng(opts.seed + 1);
+        for (auto& p : w.particles) {
+            p.r = radiusRng.uniform(0.5f * opts.radius, opts.radius);
+        }
+    }
+    return w;
+}
+
+void summarize(Result& r) {
+    std::vector<double> sorted = r.nsPerOp;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    r.min = sorted.front();
+    r.max = sorted.back();
+    r.median = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+    double sum = 0.0;
+    for (double v : sorted) sum += v;
+    r.mean = sum / n;
+    double sq = 0.0;
+    for (double v : sorted) sq += (v - r.mean) * (v - r.mean);
+    r.stddev = n > 1 ? std::sqrt(sq / (n - 1)) : 0.0;
+}
+
+class Runner {
+public:
+    explicit Runner(const BenchOptions& opts) : opts_(opts) {}
+
+    // setup() restores state before every run and is not timed; body() is
+    // the timed part and performs opsPerRep operations
+    template <typename Setup, typename Body>
+    void run(const std::string& name, const Workload& w, uint64_t opsPerRep, Setup setup, Body body) {
+        if (!opts_.filter.empty() && name.find(opts_.filter) == std::string::npos) return;
+
+        for (int i = 0; i < opts_.warmup; ++i) {
+            setup();
+            body();
+        }
+        Result r{name, &w, opsPerRep, {}, 0, 0, 0, 0, 0};
+        r.nsPerOp.reserve(opts_.reps);
+        for (int i = 0; i < opts_.reps; ++i) {
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            body();
+            auto end = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(end - start).count();
+            r.nsPerOp.push_back(ns / std::max<uint64_t>(opsPerRep, 1));
+        }
+        summarize(r);
+
+        std::cout << std::left << std::setw(28) << name << std::right
+                  << " N=" << std::setw(6) << w.N
+                  << " density=" << std::setw(5) << w.density
+                  << " radii=" << std::setw(5) << w.radii
+                  << std::fixed << std::setprecision(1)
+                  << "  median=" << std::setw(9) << r.median << " ns/op"
+                  << "  min=" << std::setw(9) << r.min
+                  << "  cv=" << std::setw(5) << (r.mean > 0 ? 100.0 * r.stddev / r.mean : 0.0) << "%"
+                  << std::defaultfloat << std::setprecision(6) << std::endl;
+        results_.push_back(std::move(r));
+    }
+
+    const std::vector<Result>& results() const { return results_; }
+
+private:
+    const BenchOptions& opts_;
+    std::vector<Result> results_;
+};
+
+void benchWorkload(Runner& runner, const Workload& w, const BenchOptions& opts) {
+    const std::vector<Particle>& base = w.particles;
+    const uint64_t N = base.size();
+    const float queryRadius = 2.0f * w.maxRadius;
+    std::vector<Particle> work;
+    std::vector<int> out;
+    auto noSetup = []() {};
+    auto restore = [&]() { work = base; };
+
+    // Quadtree, with the capacity and depth EngineQuadtree uses
+    Quadtree tree(0.0f, 0.0f, w.side, w.side, 8, 12);
+    auto buildTree = [&]() {
+        tree.clear();
+        for (const auto& p : base) tree.insert(BodyRef(p.id, p.x, p.y, p.r));
+    };
+    runner.run("quadtree.insert", w, N, noSetup, buildTree);
+    buildTree();
+    runner.run("quadtree.query", w, N, noSetup, [&]() {
+        for (const auto& p : base) {
+            tree.query(p.x, p.y, queryRadius, out);
+            sink += out.size();
+        }
+    });
+    runner.run("quadtree.queryAABB", w, N, noSetup, [&]() {
+        for (const auto& p : base) {
+            tree.queryAABB(p.x - queryRadius, p.y - queryRadius, p.x + queryRadius, p.y + queryRadius, out);
+            sink += out.size();
+        }
+    });
+
+    // Spatial hash, with the cell size EngineHash uses
+    SpatialHash hash(std::max(2.0f * w.maxRadius, 1.0f));
+    auto buildHash = [&]() {
+        hash.clear();
+        for (const auto& p : base) hash.insert(BodyRef(p.id, p.x, p.y, p.r));
+    };
+    runner.run("hash.insert", w, N, noSetup, buildHash);
+    buildHash();
+    runner.run("hash.query", w, N, noSetup, [&]() {
+        for (const auto& p : base) {
+            hash.query(p.x, p.y, queryRadius, out);
+            sink += out.size();
+        }
+    });
+
+    // Physics kernels. The pair kernels run over the candidate pairs (i < j)
+    // the broad phase returns for this workload.
+    std::vector<std::pair<int, int>> pairs;
+    for (const auto& p : base) {
+        hash.query(p.x, p.y, queryRadius, out);
+        for (int j : out) {
+            if (j > p.id) pairs.push_back({p.id, j});
+        }
+    }
+    runner.run("physics.integrate", w, N, restore, [&]() {
+        physics::integrate(work, opts.dt);
+    });
+    runner.run("physics.handle_walls", w, N, restore, [&]() {
+        physics::StepEnergy energy;
+        physics::handle_walls(work, w.side, w.side, w.maxRadius, &energy);
+        sink += static_cast<uint64_t>(energy.kinetic.value());
+    });
+    runner.run("physics.circle_overlap", w, pairs.size(), noSetup, [&]() {
+        uint64_t overlaps = 0;
+        for (const auto& pr : pairs) overlaps += physics::circle_overlap(base[pr.first], base[pr.second]);
+        sink += overlaps;
+    });
+    runner.run("physics.resolve_collision", w, pairs.size(), restore, [&]() {
+        for (const auto& pr : pairs) physics::resolve_collision(work[pr.first], work[pr.second]);
+    });
+    runner.run("physics.total_energy", w, N, noSetup, [&]() {
+        sink += static_cast<uint64_t>(physics::total_energy(base));
+    });
+    
+    // Uniform floats: the sequential generator and the per-particle counter-based one
+    RNG seqRng(opts.seed);
+    runner.run("rng.mt19937_uniform", w, N, noSetup, [&]() {
+        float sum = 0.0f;
+        for (uint64_t i = 0; i < N; ++i) sum += seqRng.uniform(0.0f, 1.0f);
+        sink += static_cast<uint64_t>(sum);
+    });
+    runner.run("rng.philox_uniform", w, N, noSetup, [&]() {
+        float sum = 0.0f;
+        for (uint64_t i = 0; i < N; i += 4) {
+            CounterRNG counterRng(opts.seed, static_cast<uint32_t>(i), 0);
+            for (int k = 0; k < 4; ++k) sum += counterRng.uniform01();
+        }
+        sink += static_cast<uint64_t>(sum);
+    });
+    
+    // All-pairs kernel on one thread, per particle (about N/2 pair tests each)
+    std::vector<std::pair<int, int>> brutePairs;
+    runner.run("brute.pairs", w, N, noSetup, [&]() {
+        bruteForcePairs(base, 1, brutePairs);
+        sink += brutePairs.size();
+    });
+
+    // Full engine steps, per particle-step. Each repetition restores the
+    // initial state and takes one untimed step, so the timed steps see the
+    // state a running engine has (EngineEvent rebuilds after a restore)
+    constexpr int kStepsPerRep = 4;
+    for (const char* method : {"quadtree", "hash", "brute", "event"}) {
+        auto engine = makeEngine(method, w.side, w.side, w.maxRadius);
+        engine->setEnergyTracking(true);
+        auto restoreAndStep = [&]() {
+            restore();
+            engine->step(work, opts.dt);
+        };
+        runner.run(std::string("step.") + method, w, N * kStepsPerRep, restoreAndStep, [&]() {
+            for (int k = 0; k < kStepsPerRep; ++k) {
+                engine->step(work, opts.dt);
+                sink += engine->getCandidatePairsChecked();
+            }
+        });
+    }
+}
+
+void writeCsv(const std::string& filename, const std::vector<Result>& results, const BenchOptions& opts) {
+    CSVWriter writer(filename);
+    if (!writer.isOpen()) {
+        std::cerr << "Warning: Could not open " << filename << std::endl;
+        return;
+    }
+    for (const char* column : {"benchmark", "N", "density", "radii", "box_side", "ops_per_rep", "warmup",
+                               "reps", "ns_per_op_median", "ns_per_op_mean", "ns_per_op_min",
+                               "ns_per_op_max", "ns_per_op_stddev"}) {
+        writer.field(column);
+    }
+    writer.endRow();
+    for (const auto& r : results) {
+        writer.field(r.name)
+              .field(r.workload->N)
+              .field(r.workload->density, 4)
+              .field(r.workload->radii)
+              .field(static_cast<double>(r.workload->side), 2)
+              .field(r.opsPerRep)
+              .field(opts.warmup)
+              .field(opts.reps)
+              .field(r.median, 2)
+              .field(r.mean, 2)
+              .field(r.min, 2)
+              .field(r.max, 2)
+              .field(r.stddev, 2);
+        writer.endRow();
+    }
+}
+
+void writeJson(const std::string& filename, const std::vector<Result>& results, const BenchOptions& opts) {
+    std::ofstream file(filename);
+    if (!file) {
+        std::cerr << "Warning: Could not open " << filename << std::endl;
+        return;
+    }
+    auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    file << "{\n"
+         << "  \"context\": {\n"
+         << "    \"date\": \"" << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M:%S") << "\",\n"
+#ifdef __VERSION__
+         << "    \"compiler\": \"" << __VERSION__ << "\",\n"
+#endif
+         << "    \"seed\": " << opts.seed << ",\n"
+         << "    \"radius\": " << opts.radius << ",\n"
+         << "    \"dt\": " << opts.dt << ",\n"
+         << "    \"warmup\": " << opts.warmup << ",\n"
+         << "    \"reps\": " << opts.reps << "\n"
+         << "  },\n"
+         << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        file << (i ? ",\n" : "\n")
+             << "    {\"name\": \"" << r.name << "\", \"N\": " << r.workload->N
+             << ", \"density\": " << r.workload->density << ", \"radii\": \"" << r.workload->radii
+             << "\", \"box_side\": " << r.workload->side << ", \"ops_per_rep\": " << r.opsPerRep
+             << ", \"ns_per_op\": {\"median\": " << r.median << ", \"mean\": " << r.mean
+             << ", \"min\": " << r.min << ", \"max\": " << r.max << ", \"stddev\": " << r.stddev
+             << "}, \"samples\": [";
+        for (size_t s = 0; s < r.nsPerOp.size(); ++s) {
+            file << (s ? ", " : "") << r.nsPerOp[s];
+        }
+        file << "]}";
+    }
+    file << "\n  ]\n}\n";
+}
+
+// Regression gate. Every scenario of the suite is stepped by every engine in
+// suiteRuns independent runs (fresh engine, same initial state) of suiteSteps
+// timed steps. The baseline file keeps every step time. Steps within a run
+// are correlated (same cache state, same clock speed), so the significance
+// test treats each run's median as one observation; the tables show the
+// pooled step distribution.
+struct Scenario {
+    const char* name;
+    int N;
+    double density;
+};
+
+const Scenario kSuite[] = {
+    {"small_sparse", 1000, 0.05},
+    {"medium_dense", 4000, 0.2},
+    {"large_sparse", 16000, 0.05},
+};
+
+struct SuiteSamples {
+    std::string scenario;
+    std::string method;
+    int N;
+    double density;
+    float radius;
+    std::vector<std::vector<double>> runNs;  // Step times of each run
+
+    std::vector<double> pooled() const {
+        std::vector<double> all;
+        for (const auto& run : runNs) all.insert(all.end(), run.begin(), run.end());
+        return all;
+    }
+    std::vector<double> runMedians() const;
+};
+
+double percentile(std::vector<double> v, double p) {
+    std::sort(v.begin(), v.end());
+    return v[static_cast<size_t>(p * (v.size() - 1))];
+}
+
+std::vector<double> SuiteSamples::runMedians() const {
+    std::vector<double> medians;
+    for (const auto& run : runNs) {
+        if (!run.empty()) medians.push_back(percentile(run, 0.5));
+    }
+    return medians;
+}
+
+std::vector<SuiteSamples> runSuite(const BenchOptions& opts) {
+    std::vector<SuiteSamples> suite;
+    for (const Scenario& sc : kSuite) {
+        Workload w = makeWorkload(sc.N, sc.density, "fixed", opts);
+        for (const auto& method : engineNames()) {
+            SuiteSamples s{sc.name, method, sc.N, sc.density, opts.radius, {}};
+            for (int run = 0; run < opts.suiteRuns; ++run) {
+                s.runNs.emplace_back();
+                s.runNs.back().reserve(opts.suiteSteps);
+                std::vector<Particle> particles = w.particles;
+                auto engine = makeEngine(method, w.side, w.side, w.maxRadius);
+                for (int i = 0; i < opts.warmup; ++i) engine->step(particles, opts.dt);
+                for (int i = 0; i < opts.suiteSteps; ++i) {
+                    auto start = std::chrono::steady_clock::now();
+                    engine->step(particles, opts.dt);
+                    auto end = std::chrono::steady_clock::now();
+                    s.runNs.back().push_back(std::chrono::duration<double, std::nano>(end - start).count());
+                }
+            }
+            std::vector<double> all = s.pooled();
+            std::cout << std::left << std::setw(14) << s.scenario << std::setw(10) << s.method << std::right
+                      << std::fixed << std::setprecision(1)
+                      << " p50=" << std::setw(9) << percentile(all, 0.5) / 1000.0 << " us"
+                      << " p95=" << std::setw(9) << percentile(all, 0.95) / 1000.0 << " us"
+                      << std::defaultfloat << std::setprecision(6) << std::endl;
+            suite.push_back(std::move(s));
+        }
+    }
+    return suite;
+}
+
+// One row per step sample: scenario,method,N,density,radius,run,step_ns
+bool saveBaseline(const std::string& filename, const std::vector<SuiteSamples>& suite) {
+    CSVWriter writer(filename);
+    if (!writer.isOpen()) {
+        std::cerr << "Error: Could not open " << filename << std::endl;
+        return false;
+    }
+    for (const char* column : {"scenario", "method", "N", "density", "radius", "run", "step_ns"}) {
+        writer.field(column);
+    }
+    writer.endRow();
+    for (const auto& s : suite) {
+        for (size_t run = 0; run < s.runNs.size(); ++run) {
+            for (double ns : s.runNs[run]) {
+                writer.field(s.scenario).field(s.method).field(s.N).field(s.density, 4)
+                      .field(static_cast<double>(s.radius), 3).field(static_cast<int>(run)).field(ns, 0);
+                writer.endRow();
+            }
+        }
+    }
+    return true;
+}
+
+bool loadBaseline(const std::string& filename, std::vector<SuiteSamples>& suite) {
+    std::ifstream file(filename);
+    if (!file) {
+        std::cerr << "Error: Could not open baseline " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    std::getline(file, line);  // Header
+    while (std::getline(file, line)) {
+        std::vector<std::string> f = splitList(line);
+        if (f.size() != 7) {
+            std::cerr << "Error: Malformed baseline row: " << line << std::endl;
+            return false;
+        }
+        try {
+            bool newScenario = suite.empty() || suite.back().scenario != f[0] || suite.back().method != f[1];
+            if (newScenario) {
+                suite.push_back({f[0], f[1], std::stoi(f[2]), std::stod(f[3]), std::stof(f[4]), {}});
+            }
+            // saveBaseline writes the runs of a scenario in order
+            size_t run = std::stoul(f[5]);
+            if (run > suite.back().runNs.size()) throw std::out_of_range("run");
+            if (run == suite.back().runNs.size()) suite.back().runNs.emplace_back();
+            suite.back().runNs[run].push_back(std::stod(f[6]));
+        } catch (const std::exception&) {
+            std::cerr << "Error: Malformed baseline row: " << line << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Smallest p-value the exact test below can give for n1 against n2 runs,
+// 1 / C(n1 + n2, n1): all of one sample above all of the other
+double minMannWhitneyP(int n1, int n2) {
+    double orderings = 1.0;
+    for (int k = 1; k <= n1; ++k) orderings = orderings * (n2 + k) / k;
+    return 1.0 / orderings;
+}
+
+// One-sided Mann-Whitney U test: p-value for "x tends to be larger than y".
+// Exact null distribution of U, which the few runs per scenario need; ties
+// count one half.
+double mannWhitneyGreater(const std::vector<double>& x, const std::vector<double>& y) {
+    const int n1 = static_cast<int>(x.size()), n2 = static_cast<int>(y.size());
+    if (n1 == 0 || n2 == 0) return 1.0;
+    double u = 0.0;
+    for (double a : x) {
+        for (double b : y) u += a > b ? 1.0 : (a == b ? 0.5 : 0.0);
+    }
+
+    // f[m][k]: orderings of m x-values and j y-values with U = k, for
+    // j = 0..n2. The largest value is either a y (U unchanged, one y fewer)
+    // or an x, which beats all j y-values.
+    const int maxU = n1 * n2;
+    std::vector<std::vector<double>> f(n1 + 1, std::vector<double>(maxU + 1, 0.0));
+    for (int m = 0; m <= n1; ++m) f[m][0] = 1.0;
+    for (int j = 1; j <= n2; ++j) {
+        std::vector<std::vector<double>> next(n1 + 1, std::vector<double>(maxU + 1, 0.0));
+        next[0][0] = 1.0;
+        for (int m = 1; m <= n1; ++m) {
+            for (int k = 0; k <= maxU; ++k) {
+                next[m][k] = f[m][k] + (k >= j ? next[m - 1][k - j] : 0.0);
+            }
+        }
+        f.swap(next);
+    }
+
+    double total = 0.0, tail = 0.0;
+    for (int k = 0; k <= maxU; ++k) {
+        total += f[n1][k];
+        if (k >= u - 1e-9) tail += f[n1][k];
+    }
+    return tail / total;
+}
+
+// Compares the current suite against the baseline. A scenario regresses when
+// its step times are significantly larger (Mann-Whitney, alpha) AND the
+// median moved by more than the threshold, so neither noise nor a
+// significant-but-negligible shift fails the gate.
+int compareBaseline(const std::vector<SuiteSamples>& baseline, const std::vector<SuiteSamples>& current,
+                    const BenchOptions& opts) {
+    std::unique_ptr<CSVWriter> diff;
+    if (!opts.diffCsv.empty()) {
+        diff = std::make_unique<CSVWriter>(opts.diffCsv);
+        for (const char* column : {"scenario", "method", "base_p50_us", "new_p50_us", "delta_pct",
+                                   "base_p95_us", "new_p95_us", "p_slower", "p_faster", "verdict"}) {
+            diff->field(column);
+        }
+        diff->endRow();
+    }
+
+    std::cout << "\n" << std::left << std::setw(14) << "scenario" << std::setw(10) << "method" << std::right
+              << std::setw(12) << "base_p50_us" << std::setw(12) << "new_p50_us" << std::setw(9) << "delta"
+              << std::setw(12) << "base_p95_us" << std::setw(12) << "new_p95_us" << std::setw(11) << "p_slower"
+              << "  verdict\n";
+    int regressions = 0;
+    for (const auto& cur : current) {
+        const SuiteSamples* base = nullptr;
+        for (const auto& b : baseline) {
+            if (b.scenario == cur.scenario && b.method == cur.method) base = &b;
+        }
+        std::string verdict;
+        if (!base || base->runNs.empty()) {
+            verdict = "no baseline";
+        } else if (base->N != cur.N || std::abs(base->density - cur.density) > 1e-6 ||
+                   std::abs(base->radius - cur.radius) > 1e-4f) {
+            verdict = "scenario changed";
+            base = nullptr;
+        }
+        if (!base) {
+            std::cout << std::left << std::setw(14) << cur.scenario << std::setw(10) << cur.method << std::right
+                      << "  " << verdict << "\n";
+            continue;
+        }
+
+        // p50 is the median of the run medians, p95 is over all steps
+        std::vector<double> baseRuns = base->runMedians(), curRuns = cur.runMedians();
+        double baseP50 = percentile(baseRuns, 0.5), curP50 = percentile(curRuns, 0.5);
+        double baseP95 = percentile(base->pooled(), 0.95), curP95 = percentile(cur.pooled(), 0.95);
+        double delta = curP50 / baseP50 - 1.0;
+        double pSlower = mannWhitneyGreater(curRuns, baseRuns);
+        double pFaster = mannWhitneyGreater(baseRuns, curRuns);
+        if (pSlower < opts.alpha && delta > opts.threshold) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (pFaster < opts.alpha && delta < -opts.threshold) {
+            verdict = "faster";
+        } else {
+            verdict = "ok";
+        }
+
+        std::cout << std::left << std::setw(14) << cur.scenario << std::setw(10) << cur.method << std::right
+                  << std::fixed << std::setprecision(1)
+                  << std::setw(12) << baseP50 / 1000.0 << std::setw(12) << curP50 / 1000.0
+                  << std::setw(8) << delta * 100.0 << "%"
+                  << std::setw(12) << baseP95 / 1000.0 << std::setw(12) << curP95 / 1000.0
+                  << std::scientific << std::setprecision(2) << std::setw(11) << pSlower
+                  << std::defaultfloat << std::setprecision(6) << "  " << verdict << "\n";
+        if (diff) {
+            diff->field(cur.scenario).field(cur.method).field(baseP50 / 1000.0, 2).field(curP50 / 1000.0, 2)
+                 .field(delta * 100.0, 2).field(baseP95 / 1000.0, 2).field(curP95 / 1000.0, 2)
+                 .fieldSci(pSlower, 3).fieldSci(pFaster, 3).field(verdict);
+            diff->endRow();
+        }
+    }
+    std::cout << std::endl;
+    if (regressions > 0) {
+        std::cerr << regressions << " significant regression(s) against " << opts.compare << std::endl;
+        return 2;
+    }
+    std::cout << "No significant regressions against " << opts.compare << std::endl;
+    return 0;
+}
+
+int runGate(const BenchOptions& opts) {
+    if (opts.suiteRuns < 1 || opts.suiteSteps < 1) {
+        std::cerr << "Error: --suite_runs and --suite_steps must be >= 1" << std::endl;
+        return 1;
+    }
+    std::vector<SuiteSamples> baseline;
+    if (!opts.compare.empty() && !loadBaseline(opts.compare, baseline)) {
+        return 1;
+    }
+    // With too few runs no ordering is significant at --alpha, and the gate
+    // could never report a regression
+    if (!opts.compare.empty()) {
+        size_t baseRuns = SIZE_MAX;
+        for (const auto& b : baseline) baseRuns = std::min(baseRuns, b.runNs.size());
+        if (baseRuns != SIZE_MAX &&
+            minMannWhitneyP(static_cast<int>(baseRuns), opts.suiteRuns) >= opts.alpha) {
+            std::cerr << "Error: " << baseRuns << " baseline and " << opts.suiteRuns
+                      << " current runs cannot reach --alpha " << opts.alpha
+                      << "; raise --suite_runs (and re-save the baseline)" << std::endl;
+            return 1;
+        }
+    } else if (minMannWhitneyP(opts.suiteRuns, opts.suiteRuns) >= opts.alpha) {
+        std::cerr << "Warning: a baseline of " << opts.suiteRuns << " runs cannot show a regression at --alpha "
+                  << opts.alpha << " against the same number of runs" << std::endl;
+    }
+    std::vector<SuiteSamples> current = runSuite(opts);
+    if (!opts.saveBaseline.empty()) {
+        if (!saveBaseline(opts.saveBaseline, current)) return 1;
+        std::cout << "Baseline written to " << opts.saveBaseline << std::endl;
+    }
+    return opts.compare.empty() ? 0 : compareBaseline(baseline, current, opts);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions opts = parseOptions(argc, argv);
+    if (opts.reps < 1 || opts.warmup < 0 || opts.radius <= 0.0f) {
+        std::cerr << "Error: --reps must be >= 1, --warmup >= 0 and --radius > 0" << std::endl;
+        return 1;
+    }
+    for (double density : opts.densities) {
+        if (density <= 0.0 || density >= 0.5) {
+            std::cerr << "Error: --density must be in (0, 0.5); random placement jams above that" << std::endl;
+            return 1;
+        }
+    }
+    for (const auto& radii : opts.radii) {
+        if (radii != "fixed" && radii != "mixed") {
+            std::cerr << "Error: Unknown radius distribution '" << radii << "' (fixed or mixed)" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!opts.saveBaseline.empty() || !opts.compare.empty()) {
+        return runGate(opts);
+    }
+
+    Runner runner(opts);
+    std::vector<std::unique_ptr<Workload>> workloads;  // Results point into these
+    for (int N : opts.Ns) {
+        for (double density : opts.densities) {
+            for (const auto& radii : opts.radii) {
+                workloads.push_back(std::make_unique<Workload>(makeWorkload(N, density, radii, opts)));
+                benchWorkload(runner, *workloads.back(), opts);
+            }
+        }
+    }
+
+    if (!opts.csv.empty()) writeCsv(opts.csv, runner.results(), opts);
+    if (!opts.json.empty()) writeJson(opts.json, runner.results(), opts);
+    return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+// Raw little-endian fields and length-prefixed strings of the checkpoint
+// sections (checkpoint.cpp, Metrics::save/load)
+namespace binary_io {
+    template <typename T>
+    void put(std::ostream& os, const T& v) {
+        os.write(reinterpret_cast<const char*>(&v), sizeof(T));
+    }
+
+    template <typename T>
+    bool get(std::istream& is, T& v) {
+        return static_cast<bool>(is.read(reinterpret_cast<char*>(&v), sizeof(T)));
+    }
+
+    inline void putString(std::ostream& os, const std::string& s) {
+        put(os, static_cast<uint64_t>(s.size()));
+        os.write(s.data(), s.size());
+    }
+
+    // Bytes between the read position and the end of the stream
+    inline uint64_t bytesLeft(std::istream& is) {
+        std::istream::pos_type pos = is.tellg();
+        if (pos == std::istream::pos_type(-1)) return 0;
+        is.seekg(0, std::ios::end);
+        std::istream::pos_type end = is.tellg();
+        is.seekg(pos);
+        return end > pos ? static_cast<uint64_t>(end - pos) : 0;
+    }
+
+    // Whether count items of itemBytes each can still be read: checked before
+    // allocating for a length that came from the file
+    inline bool fits(std::istream& is, uint64_t count, size_t itemBytes) {
+        return count <= bytesLeft(is) / itemBytes;
+    }
+
+    inline bool getString(std::istream& is, std::string& s) {
+        uint64_t n;
+        if (!get(is, n) || !fits(is, n, 1)) return false;
+        s.resize(n);
+        return n == 0 || static_cast<bool>(is.read(&s[0], n));
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+// Shape of the broad-phase structure after a build (--broadphase_stats).
+// Filled by Quadtree::collectStats / SpatialHash::collectStats by walking the
+// structure, so the build itself pays nothing when the stats are off.
+struct BroadphaseStats {
+    enum class Kind { None, Quadtree, Hash };
+    static constexpr int kOccupancyBins = 17;  // 0..15 bodies, last bin 16+
+
+    Kind kind = Kind::None;
+
+    // Bodies per leaf (quadtree, empty leaves included) or per occupied cell (hash)
+    uint64_t occupancy[kOccupancyBins] = {};
+    uint64_t buckets = 0;          // Leaves or occupied cells
+    uint64_t bodies = 0;           // Bodies held by those buckets
+    uint64_t maxOccupancy = 0;
+
+    // Quadtree
+    uint64_t nodes = 0;
+    uint64_t maxDepth = 0;
+    uint64_t internalBodies = 0;   // Straddling bodies kept at internal nodes
+
+    // Spatial hash
+    uint64_t tableSize = 0;
+    uint64_t probeTotal = 0;       // Sum over occupied cells of distance from home slot
+    uint64_t maxProbe = 0;
+    uint64_t resizes = 0;          // Since the engine was created
+
+    void addOccupancy(uint64_t count) {
+        occupancy[count < kOccupancyBins - 1 ? count : kOccupancyBins - 1]++;
+        buckets++;
+        bodies += count;
+        if (count > maxOccupancy) maxOccupancy = count;
+    }
+    double meanOccupancy() const { return buckets ? static_cast<double>(bodies) / buckets : 0.0; }
+    double avgProbe() const { return buckets ? static_cast<double>(probeTotal) / buckets : 0.0; }
+};
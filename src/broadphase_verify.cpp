@@ -0,0 +1,25 @@
+#include "broadphase_verify.hpp"
+#include "engine_brute.hpp"
+#include <algorithm>
+#include <cmath>
+
+VerifyResult verifyCandidates(const CandidateCapture& capture, int threads) {
+    VerifyResult result;
+    std::vector<std::pair<int, int>> truePairs;
+    bruteForcePairs(capture.positions, threads, truePairs);
+    result.overlapping = truePairs.size();
+
+    std::vector<std::pair<int, int>> candidates = capture.pairs;
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (const auto& pair : truePairs) {
+        const Particle& p = capture.positions[pair.first];
+        const Particle& q = capture.positions[pair.second];
+        std::pair<int, int> ids(std::min(p.id, q.id), std::max(p.id, q.id));
+        if (!std::binary_search(candidates.begin(), candidates.end(), ids)) {
+            result.missed.push_back({ids.first, ids.second, std::hypot(p.x - q.x, p.y - q.y)});
+        }
+    }
+    return result;
+}
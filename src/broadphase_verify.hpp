@@ -0,0 +1,21 @@
+#pragma once
+
+#include "engine.hpp"
+#include <cstddef>
+#include <vector>
+
+// --verify_broadphase: checks one step's CandidateCapture against every pair
+// that overlapped (physics::circle_overlap) at the positions the broad phase
+// was built from, found by bruteForcePairs()
+
+struct MissedPair {
+    int a, b;              // Ids, a < b
+    float distance;        // Centre distance at build time
+};
+
+struct VerifyResult {
+    size_t overlapping = 0;            // True overlapping pairs
+    std::vector<MissedPair> missed;    // Overlapping pairs absent from the candidates
+};
+
+VerifyResult verifyCandidates(const CandidateCapture& capture, int threads);
@@ -0,0 +1,249 @@
+#include "ccd.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int kWallX = -1;
+constexpr int kWallY = -2;
+
+// Earliest first; ties in pair/body order so the result does not depend on push order
+struct Later {
+    template <typename E>
+    bool operator()(const E& a, const E& b) const {
+        if (a.time != b.time) return a.time > b.time;
+        if (a.pair != b.pair) return a.pair > b.pair;
+        return a.body > b.body;
+    }
+};
+
+}
+
+namespace ccd {
+
+BodyRef sweptBounds(const Particle& p, float dt) {
+    float hx = 0.5f * p.vx * dt;
+    float hy = 0.5f * p.vy * dt;
+    return BodyRef(p.id, p.x + hx, p.y + hy, p.r + std::sqrt(hx * hx + hy * hy));
+}
+
+float maxSweptRadius(const std::vector<Particle>& particles, float dt) {
+    float reach = 0.0f;
+    for (const auto& p : particles) {
+        reach = std::max(reach, p.r + 0.5f * std::sqrt(p.vx * p.vx + p.vy * p.vy) * dt);
+    }
+    return reach;
+}
+
+void sweptBox(const Particle& p, float dt, float& minX, float& minY, float& maxX, float& maxY) {
+    float ex = p.x + p.vx * dt;
+    float ey = p.y + p.vy * dt;
+    minX = std::min(p.x, ex) - p.r;
+    maxX = std::max(p.x, ex) + p.r;
+    minY = std::min(p.y, ey) - p.r;
+    maxY = std::max(p.y, ey) + p.r;
+}
+
+size_t Solver::memoryBytes() const {
+    return pairs_.capacity() * sizeof(std::pair<int, int>) + pairHit_.capacity() +
+           (adjStart_.capacity() + adjFill_.capacity() + adj_.capacity() + linkHead_.capacity() +
+            found_.capacity()) * sizeof(int) +
+           links_.capacity() * sizeof(Link) + bodies_.capacity() * sizeof(Body) + heap_.capacity() * sizeof(Event);
+}
+
+void Solver::push(const Event& e) {
+    heap_.push_back(e);
+    std::push_heap(heap_.begin(), heap_.end(), Later());
+}
+
+void Solver::advance(int i, double t) {
+    Body& b = bodies_[i];
+    b.x += b.vx * (t - b.t);
+    b.y += b.vy * (t - b.t);
+    b.t = t;
+}
+
+bool Solver::paired(int i, int j) const {
+    auto other = [&](int pair) { return pairs_[pair].first == i ? pairs_[pair].second : pairs_[pair].first; };
+    for (int a = adjStart_[i]; a < adjStart_[i + 1]; ++a) {
+        if (other(adj_[a]) == j) return true;
+    }
+    for (int l = linkHead_[i]; l >= 0; l = links_[l].next) {
+        if (other(links_[l].pair) == j) return true;
+    }
+    return false;
+}
+
+void Solver::addLink(int i, int pair) {
+    links_.push_back({pair, linkHead_[i]});
+    linkHead_[i] = static_cast<int>(links_.size()) - 1;
+}
+
+// Body i just bounced at its time t: file the rest of its path and make
+// candidates of the bodies it now crosses
+void Solver::rerouteBody(int i, const std::vector<Particle>& particles, double dt, const Reroute& reroute) {
+    const Body& b = bodies_[i];
+    const float r = particles[i].r;
+    const double rest = dt - b.t;
+    const double ex = b.x + b.vx * rest;
+    const double ey = b.y + b.vy * rest;
+    const double half = 0.5 * std::sqrt(b.vx * b.vx + b.vy * b.vy) * rest;
+    BodyRef bounds(particles[i].id, static_cast<float>(0.5 * (b.x + ex)), static_cast<float>(0.5 * (b.y + ey)),
+                   r + static_cast<float>(half));
+    reroute(bounds, static_cast<float>(std::min(b.x, ex)) - r, static_cast<float>(std::min(b.y, ey)) - r,
+            static_cast<float>(std::max(b.x, ex)) + r, static_cast<float>(std::max(b.y, ey)) + r, found_);
+    for (int j : found_) {
+        if (j == i || paired(i, j)) continue;
+        int pair = static_cast<int>(pairs_.size());
+        pairs_.emplace_back(std::min(i, j), std::max(i, j));
+        pairHit_.push_back(0);
+        addLink(i, pair);
+        addLink(j, pair);
+    }
+}
+
+void Solver::predictWalls(int i, const std::vector<Particle>& particles, double now, double dt,
+                          float box_w, float box_h) {
+    const Body& b = bodies_[i];
+    if (b.count >= kMaxBouncesPerBody) return;
+    const double r = particles[i].r;
+    double tx = b.vx > 0.0 ? (box_w - r - b.x) / b.vx : b.vx < 0.0 ? (r - b.x) / b.vx : -1.0;
+    double ty = b.vy > 0.0 ? (box_h - r - b.y) / b.vy : b.vy < 0.0 ? (r - b.y) / b.vy : -1.0;
+    if (b.vx != 0.0 && now + std::max(tx, 0.0) <= dt) push({now + std::max(tx, 0.0), kWallX, i, b.count, 0});
+    if (b.vy != 0.0 && now + std::max(ty, 0.0) <= dt) push({now + std::max(ty, 0.0), kWallY, i, b.count, 0});
+}
+
+void Solver::predictPair(int pair, const std::vector<Particle>& particles, double now, double dt) {
+    const int i = pairs_[pair].first;
+    const int j = pairs_[pair].second;
+    const Body& a = bodies_[i];
+    const Body& b = bodies_[j];
+    if (a.count >= kMaxBouncesPerBody || b.count >= kMaxBouncesPerBody) return;
+    // Mutual last partners are skipped, as in EngineEvent::predict
+    if (a.lastPartner == j && b.lastPartner == i) return;
+    double dx = (b.x + b.vx * (now - b.t)) - (a.x + a.vx * (now - a.t));
+    double dy = (b.y + b.vy * (now - b.t)) - (a.y + a.vy * (now - a.t));
+    double t = now + physics::contact_time(dx, dy, b.vx - a.vx, b.vy - a.vy,
+                                           static_cast<double>(particles[i].r) + particles[j].r);
+    if (t <= dt) push({t, pair, i, a.count, b.count});
+}
+
+void Solver::solve(std::vector<Particle>& particles, float dt, float box_w, float box_h,
+                   physics::StepEnergy* energy, PairLog* log, const Reroute& reroute) {
+    const int n = static_cast<int>(particles.size());
+    collisions_ = 0;
+
+    std::sort(pairs_.begin(), pairs_.end());
+    pairs_.erase(std::unique(pairs_.begin(), pairs_.end()), pairs_.end());
+    const int pairCount = static_cast<int>(pairs_.size());
+    pairHit_.assign(pairCount, 0);
+
+    // Candidate pairs of every body, to re-predict after it bounces
+    adjStart_.assign(n + 1, 0);
+    for (const auto& pair : pairs_) {
+        adjStart_[pair.first + 1]++;
+        adjStart_[pair.second + 1]++;
+    }
+    for (int i = 0; i < n; ++i) adjStart_[i + 1] += adjStart_[i];
+    adj_.resize(adjStart_[n]);
+    adjFill_.assign(adjStart_.begin(), adjStart_.end() - 1);
+    for (int k = 0; k < pairCount; ++k) {
+        adj_[adjFill_[pairs_[k].first]++] = k;
+        adj_[adjFill_[pairs_[k].second]++] = k;
+    }
+
+    linkHead_.assign(n, -1);
+    links_.clear();
+    bodies_.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const Particle& p = particles[i];
+        bodies_[i] = {p.x, p.y, p.vx, p.vy, 0.0, 0, -1};
+    }
+
+    heap_.clear();
+    for (int i = 0; i < n; ++i) predictWalls(i, particles, 0.0, dt, box_w, box_h);
+    for (int k = 0; k < pairCount; ++k) predictPair(k, particles, 0.0, dt);
+
+    // After a bounce: new candidates along the new path, then fresh
+    // predictions for every pair and wall of the body
+    auto repredict = [&](int i, double now) {
+        if (reroute && bodies_[i].count < kMaxBouncesPerBody) rerouteBody(i, particles, dt, reroute);
+        predictWalls(i, particles, now, dt, box_w, box_h);
+        for (int a = adjStart_[i]; a < adjStart_[i + 1]; ++a) predictPair(adj_[a], particles, now, dt);
+        for (int l = linkHead_[i]; l >= 0; l = links_[l].next) predictPair(links_[l].pair, particles, now, dt);
+    };
+
+    while (!heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), Later());
+        const Event e = heap_.back();
+        heap_.pop_back();
+
+        if (e.pair < 0) {
+            const int i = e.body;
+            Body& b = bodies_[i];
+            if (b.count != e.countA) continue;
+            advance(i, e.time);
+            const double r = particles[i].r;
+            if (e.pair == kWallX) {
+                b.x = b.vx > 0.0 ? box_w - r : r;
+                b.vx = -b.vx;
+            } else {
+                b.y = b.vy > 0.0 ? box_h - r : r;
+                b.vy = -b.vy;
+            }
+            b.count++;
+            b.lastPartner = -1;
+            particles[i].collided = true;
+            repredict(i, e.time);
+            continue;
+        }
+
+        const int i = pairs_[e.pair].first;
+        const int j = pairs_[e.pair].second;
+        Body& a = bodies_[i];
+        Body& b = bodies_[j];
+        if (a.count != e.countA || b.count != e.countB) continue;
+        advance(i, e.time);
+        advance(j, e.time);
+
+        physics::elastic_bounce(b.x - a.x, b.y - a.y, a.vx, a.vy, b.vx, b.vy);
+        a.count++;
+        b.count++;
+        a.lastPartner = j;
+        b.lastPartner = i;
+        particles[i].collided = true;
+        particles[j].collided = true;
+        pairHit_[e.pair] = 1;
+        collisions_++;
+        repredict(i, e.time);
+        repredict(j, e.time);
+    }
+
+    // Rest of the step in free flight, kept inside the walls
+    for (int i = 0; i < n; ++i) {
+        advance(i, dt);
+        Particle& p = particles[i];
+        const Body& b = bodies_[i];
+        p.x = std::min(std::max(static_cast<float>(b.x), p.r), box_w - p.r);
+        p.y = std::min(std::max(static_cast<float>(b.y), p.r), box_h - p.r);
+        p.vx = static_cast<float>(b.vx);
+        p.vy = static_cast<float>(b.vy);
+        if (energy) {
+            double vx = p.vx;
+            double vy = p.vy;
+            energy->kinetic.add(0.5 * (vx * vx + vy * vy));
+            energy->momentumX.add(vx);
+            energy->momentumY.add(vy);
+        }
+    }
+
+    if (log) {
+        for (int k = 0; k < static_cast<int>(pairs_.size()); ++k) {
+            const Particle& a = particles[pairs_[k].first];
+            const Particle& b = particles[pairs_[k].second];
+            log->record(std::min(a.id, b.id), std::max(a.id, b.id), true, pairHit_[k] != 0);
+        }
+    }
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "particle.hpp"
+#include "physics.hpp"
+#include "pair_log.hpp"
+#include "body_ref.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Swept-circle continuous collision detection for the stepped engines (--ccd)
+//
+// Instead of moving every particle by dt and resolving the overlaps that
+// result, the broad phase files each particle under the bounding circle of
+// its path over the step and queries the bounding box of that path. For the
+// candidate pairs this yields, Solver computes the time of impact within the
+// step and resolves contacts in time order: each body carries the time it was
+// last moved to, a contact moves both bodies there, bounces them, and
+// re-predicts their other candidate pairs and walls. Events invalidated by an
+// earlier bounce are skipped when they come up. A bounce sends a body off its
+// swept path, so the rest of its new path is filed and queried too (Reroute),
+// and bodies it now crosses become candidates. A body that has bounced
+// kMaxBouncesPerBody times in one step flies freely for the rest of it; only
+// such bodies can end a step overlapping another.
+namespace ccd {
+    // Bounding circle of p's path over dt, to insert into the broad phase
+    BodyRef sweptBounds(const Particle& p, float dt);
+
+    // Largest sweptBounds radius of the particles
+    float maxSweptRadius(const std::vector<Particle>& particles, float dt);
+
+    // Bounding box of p's path over dt, to query the broad phase with
+    void sweptBox(const Particle& p, float dt, float& minX, float& minY, float& maxX, float& maxY);
+
+    constexpr int kMaxBouncesPerBody = 16;
+
+    // Files the bounds of a body's path after a bounce and returns (in out)
+    // the indices of the bodies whose filed paths meet its bounding box
+    using Reroute = std::function<void(const BodyRef& bounds, float minX, float minY, float maxX, float maxY,
+                                       std::vector<int>& out)>;
+
+    class Solver {
+    public:
+        void clear() { pairs_.clear(); }
+        void addPair(int i, int j) { pairs_.emplace_back(std::min(i, j), std::max(i, j)); }
+
+        // Moves every particle through dt, resolving pair and wall contacts
+        // in time-of-impact order; sets collided, logs each candidate pair once.
+        // Without reroute, pairs only meeting after a bounce are missed.
+        void solve(std::vector<Particle>& particles, float dt, float box_w, float box_h,
+                   physics::StepEnergy* energy, PairLog* log, const Reroute& reroute = Reroute());
+
+        int collisions() const { return collisions_; }
+        size_t memoryBytes() const;
+
+    private:
+        struct Body {
+            double x, y, vx, vy;
+            double t;               // Time within the step that x, y belong to
+            uint32_t count;         // Bounces so far
+            int lastPartner;        // Body of the last pair contact, -1 after a wall
+        };
+
+        // pair >= 0: contact of pairs_[pair]; kWallX / kWallY: wall of `body`
+        struct Event {
+            double time;
+            int pair;
+            int body;
+            uint32_t countA, countB;
+        };
+
+        std::vector<std::pair<int, int>> pairs_;   // Indices, first < second
+        std::vector<uint8_t> pairHit_;
+        std::vector<int> adjStart_, adjFill_, adj_;  // Pair indices per body
+        // Pairs found by rerouting, as a linked list per body
+        struct Link {
+            int pair;
+            int next;
+        };
+        std::vector<int> linkHead_;
+        std::vector<Link> links_;
+        std::vector<int> found_;
+        std::vector<Body> bodies_;
+        std::vector<Event> heap_;
+        int collisions_ = 0;
+
+        void advance(int i, double t);
+        bool paired(int i, int j) const;
+        void addLink(int i, int pair);
+        void rerouteBody(int i, const std::vector<Particle>& particles, double dt, const Reroute& reroute);
+        void predictWalls(int i, const std::vector<Particle>& particles, double now, double dt,
+                          float box_w, float box_h);
+        void predictPair(int pair, const std::vector<Particle>& particles, double now, double dt);
+        void push(const Event& e);
+    };
+}
@@ -0,0 +1,219 @@
+#include "checkpoint.hpp"
+#include "trace.hpp"
+#include "binary_io.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'P', 'B', 'C', 'K', 'P', 'T', '1', '\0'};
+constexpr uint32_t VERSION = 1;
+
+using binary_io::put;
+using binary_io::get;
+using binary_io::putString;
+using binary_io::getString;
+
+// Run parameters that must match for a resumed run to be the same run
+void putFingerprint(std::ostream& os, const SimConfig& config) {
+    put(os, static_cast<int32_t>(config.N));
+    put(os, config.radius);
+    put(os, config.box_w);
+    put(os, config.box_h);
+    put(os, config.dt);
+    put(os, config.seed);
+    putString(os, config.method);
+    putString(os, config.format);
+}
+
+bool openHeader(std::ifstream& file, const std::string& path) {
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open checkpoint: " << path << std::endl;
+        return false;
+    }
+    char magic[sizeof(MAGIC)];
+    uint32_t version = 0, particleBytes = 0;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !get(file, version) || version != VERSION ||
+        !get(file, particleBytes) || particleBytes != sizeof(Particle)) {
+        std::cerr << "Error: Not a compatible particle-box checkpoint: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Everything after the fingerprint; particles are read straight into place
+bool readSections(std::istream& file, const std::string& path, CheckpointState& state) {
+    int32_t step = 0;
+    uint64_t count = 0;
+    bool ok = get(file, step) &&
+              get(file, state.simulatedTime) &&
+              get(file, state.initialEnergy) &&
+              getString(file, state.rngState) &&
+              getString(file, state.metricsState) &&
+              getString(file, state.stepsOutputState) &&
+              getString(file, state.pairsOutputState) &&
+              getString(file, state.phasesOutputState) &&
+              getString(file, state.broadphaseOutputState) &&
+              get(file, state.engineParams) &&
+              get(file, state.clusteringSignature) &&
+              getString(file, state.engineState) &&
+              getString(file, state.verifyOutputState) &&
+              get(file, count) &&
+              binary_io::fits(file, count, sizeof(Particle));
+    if (ok) {
+        state.step = step;
+        state.particles.resize(count);
+        ok = static_cast<bool>(file.read(reinterpret_cast<char*>(state.particles.data()),
+                                         count * sizeof(Particle)));
+    }
+    if (!ok) {
+        std::cerr << "Error: Truncated checkpoint: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+namespace checkpoint {
+
+std::string serialize(const SimConfig& config, const CheckpointState& state) {
+    std::ostringstream os(std::ios::binary);
+    os.write(MAGIC, sizeof(MAGIC));
+    put(os, VERSION);
+    put(os, static_cast<uint32_t>(sizeof(Particle)));
+    putFingerprint(os, config);
+
+    put(os, static_cast<int32_t>(state.step));
+    put(os, state.simulatedTime);
+    put(os, state.initialEnergy);
+    putString(os, state.rngState);
+    putString(os, state.metricsState);
+    putString(os, state.stepsOutputState);
+    putString(os, state.pairsOutputState);
+    putString(os, state.phasesOutputState);
+    putString(os, state.broadphaseOutputState);
+    put(os, state.engineParams);
+    put(os, state.clusteringSignature);
+    putString(os, state.engineState);
+    putString(os, state.verifyOutputState);
+
+    put(os, static_cast<uint64_t>(state.particles.size()));
+    os.write(reinterpret_cast<const char*>(state.particles.data()),
+             state.particles.size() * sizeof(Particle));
+    return os.str();
+}
+
+bool isCheckpoint(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    char magic[sizeof(MAGIC)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool load(const std::string& path, const SimConfig& config, CheckpointState& state) {
+    std::ifstream file(path, std::ios::binary);
+    if (!openHeader(file, path)) {
+        return false;
+    }
+
+    std::ostringstream expected(std::ios::binary);
+    putFingerprint(expected, config);
+    std::string want = expected.str();
+    std::string have(want.size(), '\0');
+    if (!file.read(&have[0], have.size()) || have != want) {
+        std::cerr << "Error: Checkpoint " << path << " was written with different "
+                  << "--N/--radius/--box/--dt/--seed/--method/--format" << std::endl;
+        return false;
+    }
+    return readSections(file, path, state);
+}
+
+bool readParticles(const std::string& path, const SimConfig& config, std::vector<Particle>& particles) {
+    std::ifstream file(path, std::ios::binary);
+    if (!openHeader(file, path)) {
+        return false;
+    }
+
+    // Fingerprint fields; only the geometry has to match
+    int32_t N = 0;
+    float radius = 0.0f, box_w = 0.0f, box_h = 0.0f, dt = 0.0f;
+    uint64_t seed = 0;
+    std::string method, format;
+    if (!get(file, N) || !get(file, radius) || !get(file, box_w) || !get(file, box_h) ||
+        !get(file, dt) || !get(file, seed) || !getString(file, method) || !getString(file, format)) {
+        std::cerr << "Error: Truncated checkpoint: " << path << std::endl;
+        return false;
+    }
+    if (N != config.N || radius != config.radius || box_w != config.box_w || box_h != config.box_h) {
+        std::cerr << "Error: " << path << " holds N=" << N << " radius=" << radius << " box=" << box_w
+                  << "x" << box_h << ", run has N=" << config.N << " radius=" << config.radius
+                  << " box=" << config.box_w << "x" << config.box_h << std::endl;
+        return false;
+    }
+
+    CheckpointState state;
+    if (!readSections(file, path, state)) {
+        return false;
+    }
+    particles = std::move(state.particles);
+    return true;
+}
+
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& path) : path_(path) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    wait();
+}
+
+void CheckpointWriter::wait() {
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+void CheckpointWriter::submit(std::string blob) {
+    wait();
+    worker_ = std::thread(&CheckpointWriter::writeAtomically, path_, std::move(blob));
+}
+
+void CheckpointWriter::writeAtomically(const std::string& path, const std::string& blob) {
+    trace::setThreadName("checkpoint");
+    trace::Scope scope("write_checkpoint", "io");
+    std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Warning: Could not write checkpoint " << tmp << ": " << std::strerror(errno) << std::endl;
+        return;
+    }
+
+    const char* data = blob.data();
+    size_t left = blob.size();
+    while (left > 0) {
+        ssize_t n = ::write(fd, data, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Warning: Checkpoint write failed: " << std::strerror(errno) << std::endl;
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return;
+        }
+        data += n;
+        left -= static_cast<size_t>(n);
+    }
+    // Data must be durable before the rename makes it the current checkpoint
+    ::fsync(fd);
+    ::close(fd);
+
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Warning: Could not replace checkpoint " << path << ": " << std::strerror(errno) << std::endl;
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "particle.hpp"
+#include "sim_config.hpp"
+#include "engine.hpp"
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Everything main() needs to resume a run where it left off
+struct CheckpointState {
+    int step = 0;                        // Next step to execute
+    double simulatedTime = 0.0;
+    double initialEnergy = 0.0;
+    std::string rngState;                // RNG::save()
+    std::string metricsState;            // Metrics::save()
+    std::string stepsOutputState;        // saveState() of the steps.* writer
+    std::string pairsOutputState;        // PairLog::saveState()
+    std::string phasesOutputState;       // saveState() of the phases.csv writer
+    std::string broadphaseOutputState;   // saveState() of the broadphase.csv writer, if any
+    std::string verifyOutputState;       // saveState() of the broadphase_misses.csv writer, if any
+    EngineParams engineParams;           // Broad-phase parameters in use (--autotune)
+    double clusteringSignature = 0.0;    // At the last tuning (--autotune_every)
+    std::string engineState;             // Engine::saveState()
+    std::vector<Particle> particles;
+};
+
+namespace checkpoint {
+    // Binary snapshot: magic, config fingerprint, then length-prefixed sections
+    std::string serialize(const SimConfig& config, const CheckpointState& state);
+
+    // Reads a snapshot; fails (with a message on stderr) if it does not match config
+    bool load(const std::string& path, const SimConfig& config, CheckpointState& state);
+    
+    // Whether the file starts like a snapshot
+    bool isCheckpoint(const std::string& path);
+    
+    // Particles of a snapshot with the same N, radius and box as config (the
+    // rest of the run may differ), for --init
+    bool readParticles(const std::string& path, const SimConfig& config, std::vector<Particle>& particles);
+}
+
+// Writes snapshots on a background thread through <path>.tmp + rename(), so the
+// file at <path> is always a complete checkpoint and the step loop only pays
+// for serializing into memory.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const std::string& path);
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void submit(std::string blob);  // Waits for the previous write, then starts this one
+    void wait();
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+    std::thread worker_;
+
+    static void writeAtomically(const std::string& path, const std::string& blob);
+};
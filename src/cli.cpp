@@ -35,10 +35,77 @@ SimConfig CLI::parse(int argc, char* argv[]) {
             config.outdir = argv[++i];
         } else if (arg == "--log_pairs") {
             config.log_pairs = true;
+        } else if (arg == "--log_pairs_sample" && i + 1 < argc) {
+            config.log_pairs = true;
+            config.log_pairs_sample = parse_float(argv[++i]);
+        } else if (arg == "--export_pairs" && i + 1 < argc) {
+            config.export_pairs = argv[++i];
         } else if (arg == "--no_energy") {
             config.no_energy = true;
         } else if (arg == "--summary_only") {
             config.summary_only = true;
+        } else if (arg == "--format" && i + 1 < argc) {
+            config.format = argv[++i];
+        } else if (arg == "--keyframe_every" && i + 1 < argc) {
+            config.keyframe_every = parse_int(argv[++i]);
+        } else if (arg == "--quant_bits" && i + 1 < argc) {
+            config.quant_bits = parse_int(argv[++i]);
+        } else if (arg == "--hist_digits" && i + 1 < argc) {
+            config.hist_digits = parse_int(argv[++i]);
+        } else if (arg == "--perf_counters") {
+            config.perf_counters = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            config.trace = argv[++i];
+        } else if (arg == "--trace_sample" && i + 1 < argc) {
+            config.trace_sample = parse_int(argv[++i]);
+        } else if (arg == "--broadphase_stats") {
+            config.broadphase_stats = true;
+        } else if (arg == "--metrics_port" && i + 1 < argc) {
+            config.metrics_port = parse_int(argv[++i]);
+        } else if (arg == "--init_mode" && i + 1 < argc) {
+            config.init_mode = argv[++i];
+        } else if (arg == "--ccd") {
+            config.ccd = true;
+        } else if (arg == "--init" && i + 1 < argc) {
+            config.init_file = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            config.threads = parse_int(argv[++i]);
+        } else if (arg == "--verify_broadphase" && i + 1 < argc) {
+            config.verify_broadphase = parse_int(argv[++i]);
+        } else if (arg == "--auto_probe_every" && i + 1 < argc) {
+            config.auto_probe_every = parse_int(argv[++i]);
+        } else if (arg == "--autotune") {
+            config.autotune = true;
+        } else if (arg == "--autotune_steps" && i + 1 < argc) {
+            config.autotune_steps = parse_int(argv[++i]);
+        } else if (arg == "--autotune_every" && i + 1 < argc) {
+            config.autotune = true;
+            config.autotune_every = parse_int(argv[++i]);
+        } else if (arg == "--scaling" && i + 1 < argc) {
+            config.scaling = argv[++i];
+        } else if (arg == "--scaling_density" && i + 1 < argc) {
+            config.scaling_density.clear();
+            for (const auto& part : split_string(argv[++i], ',')) {
+                config.scaling_density.push_back(std::stod(part));
+            }
+        } else if (arg == "--scaling_n" && i + 1 < argc) {
+            auto parts = split_string(argv[++i], ',');
+            if (parts.size() == 2) {
+                config.scaling_n_min = parse_int(parts[0]);
+                config.scaling_n_max = parse_int(parts[1]);
+            }
+        } else if (arg == "--scaling_time" && i + 1 < argc) {
+            config.scaling_time = parse_float(argv[++i]);
+        } else if (arg == "--scaling_jobs" && i + 1 < argc) {
+            config.scaling_jobs = parse_int(argv[++i]);
+        } else if (arg == "--checkpoint_every" && i + 1 < argc) {
+            config.checkpoint_every = parse_int(argv[++i]);
+        } else if (arg == "--restart" && i + 1 < argc) {
+            config.restart = argv[++i];
+        } else if (arg == "--stream" && i + 1 < argc) {
+            config.stream = argv[++i];
+        } else if (arg == "--stream_every" && i + 1 < argc) {
+            config.stream_every = parse_int(argv[++i]);
         } else if (arg == "--help" || arg == "-h") {
             print_usage(argv[0]);
             std::exit(0);
@@ -51,7 +118,8 @@ SimConfig CLI::parse(int argc, char* argv[]) {
 void CLI::print_usage(const char* progname) {
     std::cout << "Usage: " << progname << " [options]\n"
               << "Options:\n"
-              << "  --method {quadtree|hash}     Broad-phase method (default: quadtree)\n"
+              << "  --method {quadtree|hash|auto|brute|event} Broad-phase method; auto switches at runtime, brute is O(N^2),\n"
+              << "                               event jumps between exact collision times (default: quadtree)\n"
               << "  --N <int>                    Number of particles (default: 100)\n"
               << "  --radius <float>             Particle radius (default: 3.0)\n"
               << "  --box <W>x<H>                Box dimensions (default: 1200x800)\n"
@@ -61,9 +129,38 @@ void CLI::print_usage(const char* progname) {
               << "  --seed <uint64>              RNG seed (default: 1337)\n"
               << "  --headless                   No rendering window\n"
               << "  --outdir <path>              Output directory (required)\n"
-              << "  --log_pairs                  Log candidate pairs\n"
+              << "  --log_pairs                  Log candidate pairs to pairs.bin\n"
+              << "  --log_pairs_sample <float>   Keep this fraction of candidate pairs (implies --log_pairs)\n"
+              << "  --export_pairs <file>        Convert a pairs.bin to pairs.csv and exit\n"
               << "  --no_energy                  Skip energy calculations\n"
               << "  --summary_only               Only write summary.csv, no per-step logs\n"
+              << "  --format {csv|bin|delta}     Per-step log format: steps.csv, steps.bin or steps.dtraj (default: csv)\n"
+              << "  --keyframe_every <int>       Delta format: keyframe interval in frames (default: 64)\n"
+              << "  --quant_bits <int>           Delta format: position bits per box dimension (default: 20)\n"
+              << "  --checkpoint_every <int>     Write <outdir>/checkpoint.bin every N steps (default: off)\n"
+              << "  --restart <file>             Resume a run from a checkpoint\n"
+              << "  --stream shm:<name>          Publish live snapshots to POSIX shared memory\n"
+              << "  --stream_every <int>         Publish every N steps (default: 1)\n"
+              << "  --hist_digits <int>          Significant digits of the latency histograms, 1-5 (default: 3)\n"
+              << "  --perf_counters              Read hardware counters around each engine phase (Linux)\n"
+              << "  --trace <file>               Write a Chrome/Perfetto trace of steps, phases and writes\n"
+              << "  --trace_sample <int>         Trace every Nth step (default: 1)\n"
+              << "  --broadphase_stats           Log quadtree/hash structure stats per step (broadphase.csv)\n"
+              << "  --metrics_port <int>         Serve Prometheus metrics on 127.0.0.1:<port> (default: off)\n"
+              << "  --init_mode {random|tiled|lattice} Initial placement; tiled and lattice are parallel (default: random)\n"
+              << "  --init <file>                Start from a checkpoint, steps.bin/.dtraj (last frame) or steps.csv (last step)\n"
+              << "  --ccd                        Swept-circle collisions in time-of-impact order (quadtree, hash, auto)\n"
+              << "  --threads <int>              Threads of --method brute, --verify_broadphase and init (default: one per core)\n"
+              << "  --verify_broadphase <int>    Every N steps, check the candidates cover all overlapping pairs\n"
+              << "  --auto_probe_every <int>     --method auto: steps between cost probes of other engines (default: 100)\n"
+              << "  --autotune                   Pick broad-phase parameters by timing trial steps at startup\n"
+              << "  --autotune_steps <int>       Timed trial steps per candidate setting (default: 5)\n"
+              << "  --autotune_every <int>       Re-tune when clustering changes, checked every N steps (implies --autotune)\n"
+              << "  --scaling {density|box}      Sweep N for every engine at fixed area fraction or fixed --box, then exit\n"
+              << "  --scaling_density <list>     Area fractions swept with --scaling density (default: 0.05)\n"
+              << "  --scaling_n <min>,<max>      N range of the sweep, half-decade steps (default: 100,1000000)\n"
+              << "  --scaling_time <float>       Wall-time cutoff per sweep run in seconds (default: 2)\n"
+              << "  --scaling_jobs <int>         Sweep runs executed concurrently (default: one per core)\n"
               << "  --help, -h                   Show this help\n";
 }
 
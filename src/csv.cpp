@@ -1,37 +1,153 @@
 #include "csv.hpp"
 #include <iostream>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
 
-CSVWriter::CSVWriter(const std::string& filename, bool append) {
-    if (append) {
-        file_.open(filename, std::ios::app);
-    } else {
-        file_.open(filename);
-    }
-    if (!file_.is_open()) {
+CSVWriter::CSVWriter(const std::string& filename, bool append)
+    : fd_(-1), buffer_(BUFFER_SIZE), used_(0), rowStarted_(false) {
+    int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+    fd_ = ::open(filename.c_str(), flags, 0644);
+    if (fd_ < 0) {
         std::cerr << "Warning: Could not open CSV file: " << filename << std::endl;
     }
 }
 
 CSVWriter::~CSVWriter() {
-    if (file_.is_open()) {
-        file_.close();
+    if (fd_ >= 0) {
+        flush();
+        ::close(fd_);
     }
 }
 
 void CSVWriter::writeRow(const std::vector<std::string>& values) {
-    if (!file_.is_open()) return;
-    
-    for (size_t i = 0; i < values.size(); ++i) {
-        file_ << values[i];
-        if (i < values.size() - 1) {
-            file_ << ",";
+    if (fd_ < 0) return;
+
+    for (const auto& value : values) {
+        field(value);
+    }
+    endRow();
+}
+
+char* CSVWriter::reserve(size_t n) {
+    if (used_ + n + 1 > buffer_.size()) {
+        flush();
+    }
+    if (rowStarted_) {
+        buffer_[used_++] = ',';
+    }
+    rowStarted_ = true;
+    return buffer_.data() + used_;
+}
+
+CSVWriter& CSVWriter::field(int value) {
+    return field(static_cast<int64_t>(value));
+}
+
+CSVWriter& CSVWriter::field(int64_t value) {
+    if (fd_ < 0) return *this;
+    char* out = reserve(MAX_FIELD_CHARS);
+    used_ = std::to_chars(out, out + MAX_FIELD_CHARS, value).ptr - buffer_.data();
+    return *this;
+}
+
+CSVWriter& CSVWriter::field(uint64_t value) {
+    if (fd_ < 0) return *this;
+    char* out = reserve(MAX_FIELD_CHARS);
+    used_ = std::to_chars(out, out + MAX_FIELD_CHARS, value).ptr - buffer_.data();
+    return *this;
+}
+
+CSVWriter& CSVWriter::field(double value, int precision) {
+    if (fd_ < 0) return *this;
+    char* out = reserve(MAX_FIELD_CHARS);
+    auto res = std::to_chars(out, out + MAX_FIELD_CHARS, value, std::chars_format::fixed, precision);
+    if (res.ec != std::errc()) {
+        // Magnitude too large for fixed notation in MAX_FIELD_CHARS
+        res = std::to_chars(out, out + MAX_FIELD_CHARS, value, std::chars_format::scientific, precision);
+    }
+    used_ = res.ptr - buffer_.data();
+    return *this;
+}
+
+CSVWriter& CSVWriter::fieldSci(double value, int precision) {
+    if (fd_ < 0) return *this;
+    char* out = reserve(MAX_FIELD_CHARS);
+    used_ = std::to_chars(out, out + MAX_FIELD_CHARS, value, std::chars_format::scientific, precision).ptr
+            - buffer_.data();
+    return *this;
+}
+
+CSVWriter& CSVWriter::field(const std::string& value) {
+    return fieldRaw(value.data(), value.size());
+}
+
+CSVWriter& CSVWriter::field(const char* value) {
+    return fieldRaw(value, std::strlen(value));
+}
+
+CSVWriter& CSVWriter::fieldRaw(const char* data, size_t n) {
+    if (fd_ < 0) return *this;
+    if (n + 2 > buffer_.size()) {
+        // Too long to stage in the buffer: write through
+        reserve(0);
+        flush();
+        writeAll(data, n);
+        return *this;
+    }
+    char* out = reserve(n);
+    std::memcpy(out, data, n);
+    used_ += n;
+    return *this;
+}
+
+void CSVWriter::endRow() {
+    if (fd_ < 0) return;
+    if (used_ + 1 > buffer_.size()) {
+        flush();
+    }
+    buffer_[used_++] = '\n';
+    rowStarted_ = false;
+}
+
+void CSVWriter::writeAll(const char* data, size_t n) {
+    while (n > 0) {
+        ssize_t written = ::write(fd_, data, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Warning: CSV write failed: " << std::strerror(errno) << std::endl;
+            return;
         }
+        data += written;
+        n -= static_cast<size_t>(written);
     }
-    file_ << "\n";
 }
 
 void CSVWriter::flush() {
-    if (file_.is_open()) {
-        file_.flush();
+    if (fd_ >= 0 && used_ > 0) {
+        writeAll(buffer_.data(), used_);
+        used_ = 0;
+    }
+}
+
+std::string CSVWriter::saveState() {
+    flush();
+    uint64_t length = 0;
+    if (fd_ >= 0) {
+        off_t end = ::lseek(fd_, 0, SEEK_END);
+        length = end > 0 ? static_cast<uint64_t>(end) : 0;
     }
+    return std::string(reinterpret_cast<const char*>(&length), sizeof(length));
+}
+
+bool CSVWriter::restoreState(const std::string& state) {
+    if (fd_ < 0 || state.size() != sizeof(uint64_t)) return false;
+    uint64_t length;
+    std::memcpy(&length, state.data(), sizeof(length));
+    used_ = 0;
+    rowStarted_ = false;
+    return ::ftruncate(fd_, static_cast<off_t>(length)) == 0;
 }
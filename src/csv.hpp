@@ -1,18 +1,52 @@
 #pragma once
 
 #include <string>
-#include <fstream>
 #include <vector>
+#include <cstdint>
 
+// Buffered CSV writer. Rows are either written whole with writeRow() or built
+// field by field (formatted with std::to_chars into an internal buffer) and
+// terminated with endRow(). The buffer goes to the file descriptor with
+// write(2) in large chunks.
 class CSVWriter {
 public:
     CSVWriter(const std::string& filename, bool append = false);
     ~CSVWriter();
-    
+
+    CSVWriter(const CSVWriter&) = delete;
+    CSVWriter& operator=(const CSVWriter&) = delete;
+
     void writeRow(const std::vector<std::string>& values);
+
+    // Streaming row builder
+    CSVWriter& field(int value);
+    CSVWriter& field(int64_t value);
+    CSVWriter& field(uint64_t value);
+    CSVWriter& field(double value, int precision = 6);        // fixed, like std::to_string
+    CSVWriter& fieldSci(double value, int precision = 6);     // scientific
+    CSVWriter& field(const std::string& value);
+    CSVWriter& field(const char* value);
+    void endRow();
+
     void flush();
-    bool isOpen() const { return file_.is_open(); }
+    bool isOpen() const { return fd_ >= 0; }
+    size_t memoryBytes() const { return buffer_.capacity(); }
     
+    // Checkpoint support: saveState() flushes and records the file length,
+    // restoreState() truncates the file back to it (open with append = true)
+    std::string saveState();
+    bool restoreState(const std::string& state);
+
 private:
-    std::ofstream file_;
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+    static constexpr size_t MAX_FIELD_CHARS = 128;  // Longest formatted number
+
+    int fd_;
+    std::vector<char> buffer_;
+    size_t used_;
+    bool rowStarted_;
+
+    CSVWriter& fieldRaw(const char* data, size_t n);
+    char* reserve(size_t n);   // Separator-aware space for the next field
+    void writeAll(const char* data, size_t n);
 };
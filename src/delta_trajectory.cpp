@@ -0,0 +1,418 @@
+#include "delta_trajectory.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint8_t FRAME_KEY = 0;
+constexpr uint8_t FRAME_DELTA = 1;
+constexpr int COLUMNS = 4;  // x, y, vx, vy
+
+inline uint64_t zigzag(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline void putVarint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = *p++;
+        v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// Token stream: (zigzag(r) << 1) for a nonzero residual, (run << 1) | 1 for a run of zeros
+void encodeResiduals(std::vector<uint8_t>& out, const int64_t* r, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        if (r[i] == 0) {
+            size_t run = 1;
+            while (i + run < n && r[i + run] == 0) ++run;
+            putVarint(out, (static_cast<uint64_t>(run) << 1) | 1);
+            i += run;
+        } else {
+            putVarint(out, zigzag(r[i]) << 1);
+            ++i;
+        }
+    }
+}
+
+bool decodeResiduals(const unsigned char*& p, const unsigned char* end, int64_t* r, size_t n) {
+    size_t i = 0;
+    while (i < n) {
+        uint64_t token;
+        if (!getVarint(p, end, token)) return false;
+        if (token & 1) {
+            uint64_t run = token >> 1;
+            if (run == 0 || run > n - i) return false;
+            std::fill(r + i, r + i + run, 0);
+            i += run;
+        } else {
+            r[i++] = unzigzag(token >> 1);
+        }
+    }
+    return true;
+}
+
+// Prediction for column c of particle i from the previous quantized frame
+inline int64_t predict(const int64_t* prev, size_t N, int c, size_t i) {
+    if (c < 2) {
+        return prev[c * N + i] + prev[(c + 2) * N + i];  // x + v (v quantum = x quantum / dt)
+    }
+    return prev[c * N + i];
+}
+
+}
+
+DeltaTrajectoryWriter::DeltaTrajectoryWriter(const std::string& filename, int N, float dt,
+                                             float box_w, float box_h, float radius, uint64_t seed,
+                                             int keyframeEvery, int quantBits, bool append)
+    : filename_(filename), frameCount_(0), offset_(0) {
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, "PBDTRJ1", 8);
+    header_.version = 1;
+    header_.header_bytes = sizeof(DeltaTrajectoryHeader);
+    header_.N = static_cast<uint64_t>(N);
+    header_.dt = dt;
+    header_.box_w = box_w;
+    header_.box_h = box_h;
+    header_.radius = radius;
+    header_.quant_bits = static_cast<uint32_t>(std::clamp(quantBits, 8, 30));
+    header_.seed = seed;
+    header_.keyframe_every = static_cast<uint32_t>(std::max(keyframeEvery, 1));
+    header_.endian = 0x01020304u;
+    double levels = std::ldexp(1.0, static_cast<int>(header_.quant_bits));
+    header_.pos_quantum_x = box_w / levels;
+    header_.pos_quantum_y = box_h / levels;
+    header_.vel_quantum_x = header_.pos_quantum_x / dt;
+    header_.vel_quantum_y = header_.pos_quantum_y / dt;
+
+    prev_.assign(COLUMNS * header_.N, 0);
+    cur_.assign(COLUMNS * header_.N, 0);
+
+    if (append) {
+        file_.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+        if (file_.is_open()) {
+            file_.seekp(0, std::ios::end);
+            offset_ = static_cast<uint64_t>(file_.tellp());
+            return;
+        }
+    }
+    file_.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file_.is_open()) {
+        std::cerr << "Warning: Could not open trajectory file: " << filename << std::endl;
+        return;
+    }
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    offset_ = sizeof(header_);
+}
+
+DeltaTrajectoryWriter::~DeltaTrajectoryWriter() {
+    close();
+}
+
+void DeltaTrajectoryWriter::writeFrame(int step, const std::vector<Particle>& particles) {
+    if (!file_.is_open()) return;
+
+    const size_t N = header_.N;
+    const double inv[COLUMNS] = {
+        1.0 / header_.pos_quantum_x, 1.0 / header_.pos_quantum_y,
+        1.0 / header_.vel_quantum_x, 1.0 / header_.vel_quantum_y
+    };
+
+    size_t count = std::min(N, particles.size());
+    for (size_t i = 0; i < count; ++i) {
+        const auto& p = particles[i];
+        cur_[0 * N + i] = std::llround(p.x * inv[0]);
+        cur_[1 * N + i] = std::llround(p.y * inv[1]);
+        cur_[2 * N + i] = std::llround(p.vx * inv[2]);
+        cur_[3 * N + i] = std::llround(p.vy * inv[3]);
+    }
+
+    bool key = (frameCount_ % header_.keyframe_every) == 0;
+
+    body_.clear();
+    std::vector<int64_t>& residual = prev_;  // Reused in place: prev_ is replaced by cur_ below
+    if (key) {
+        for (int c = 0; c < COLUMNS; ++c) {
+            encodeResiduals(body_, &cur_[c * N], N);
+        }
+    } else {
+        // Positions predict from the previous velocity, so compute them before overwriting it
+        for (size_t i = 0; i < N; ++i) {
+            for (int c = 0; c < 2; ++c) {
+                residual[c * N + i] = cur_[c * N + i] - predict(prev_.data(), N, c, i);
+            }
+        }
+        for (size_t i = 0; i < N; ++i) {
+            for (int c = 2; c < COLUMNS; ++c) {
+                residual[c * N + i] = cur_[c * N + i] - prev_[c * N + i];
+            }
+        }
+        for (int c = 0; c < COLUMNS; ++c) {
+            encodeResiduals(body_, &residual[c * N], N);
+        }
+    }
+
+    size_t bitsStart = body_.size();
+    body_.resize(bitsStart + (N + 7) / 8, 0);
+    for (size_t i = 0; i < count; ++i) {
+        if (particles[i].collided) {
+            body_[bitsStart + (i >> 3)] |= static_cast<uint8_t>(1u << (i & 7));
+        }
+    }
+
+    record_.clear();
+    record_.push_back(key ? FRAME_KEY : FRAME_DELTA);
+    putVarint(record_, static_cast<uint64_t>(step));
+    putVarint(record_, body_.size());
+
+    if (key) {
+        keyframes_.push_back({frameCount_, static_cast<uint64_t>(step), offset_});
+    }
+    file_.write(reinterpret_cast<const char*>(record_.data()), record_.size());
+    file_.write(reinterpret_cast<const char*>(body_.data()), body_.size());
+    offset_ += record_.size() + body_.size();
+
+    prev_.swap(cur_);
+    frameCount_++;
+}
+
+void DeltaTrajectoryWriter::close() {
+    if (!file_.is_open()) return;
+
+    header_.frame_count = frameCount_;
+    header_.keyframe_count = keyframes_.size();
+    header_.index_offset = offset_;
+    file_.write(reinterpret_cast<const char*>(keyframes_.data()),
+                keyframes_.size() * sizeof(DeltaKeyframeEntry));
+
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    file_.close();
+}
+
+std::string DeltaTrajectoryWriter::saveState() {
+    if (file_.is_open()) {
+        file_.flush();
+    }
+    std::string state;
+    auto append = [&state](const void* p, size_t n) {
+        state.append(static_cast<const char*>(p), n);
+    };
+    uint64_t keyframeCount = keyframes_.size();
+    append(&frameCount_, sizeof(frameCount_));
+    append(&offset_, sizeof(offset_));
+    append(&keyframeCount, sizeof(keyframeCount));
+    append(keyframes_.data(), keyframes_.size() * sizeof(DeltaKeyframeEntry));
+    append(prev_.data(), prev_.size() * sizeof(int64_t));
+    return state;
+}
+
+bool DeltaTrajectoryWriter::restoreState(const std::string& state) {
+    if (!file_.is_open() || state.size() < 3 * sizeof(uint64_t)) return false;
+    const char* p = state.data();
+    uint64_t frames, offset, keyframeCount;
+    std::memcpy(&frames, p, sizeof(frames));
+    std::memcpy(&offset, p + 8, sizeof(offset));
+    std::memcpy(&keyframeCount, p + 16, sizeof(keyframeCount));
+    p += 3 * sizeof(uint64_t);
+    if (keyframeCount > state.size() / sizeof(DeltaKeyframeEntry)) return false;
+
+    size_t expected = 3 * sizeof(uint64_t) + keyframeCount * sizeof(DeltaKeyframeEntry) +
+                      prev_.size() * sizeof(int64_t);
+    if (state.size() != expected) return false;
+
+    keyframes_.resize(keyframeCount);
+    std::memcpy(keyframes_.data(), p, keyframeCount * sizeof(DeltaKeyframeEntry));
+    p += keyframeCount * sizeof(DeltaKeyframeEntry);
+    std::memcpy(prev_.data(), p, prev_.size() * sizeof(int64_t));
+    frameCount_ = frames;
+    offset_ = offset;
+
+    file_.close();
+    if (::truncate(filename_.c_str(), static_cast<off_t>(offset_)) != 0) {
+        std::cerr << "Warning: Could not truncate trajectory file: " << filename_ << std::endl;
+        return false;
+    }
+    file_.open(filename_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file_.is_open()) return false;
+    // Drop the index of an earlier clean close, as in TrajectoryWriter::restoreState
+    header_.frame_count = 0;
+    header_.keyframe_count = 0;
+    header_.index_offset = 0;
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    file_.seekp(static_cast<std::streamoff>(offset_));
+    return true;
+}
+
+DeltaTrajectoryReader::DeltaTrajectoryReader(const std::string& filename)
+    : data_(nullptr), size_(0), cursor_(0), end_(0), havePrev_(false) {
+    std::memset(&header_, 0, sizeof(header_));
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Warning: Could not open trajectory file: " << filename << std::endl;
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(DeltaTrajectoryHeader)) {
+        std::cerr << "Warning: Trajectory file too small: " << filename << std::endl;
+        ::close(fd);
+        return;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Warning: Could not map trajectory file: " << filename << std::endl;
+        size_ = 0;
+        return;
+    }
+    data_ = static_cast<const unsigned char*>(mapped);
+    std::memcpy(&header_, data_, sizeof(header_));
+
+    if (std::memcmp(header_.magic, "PBDTRJ1", 8) != 0 || header_.endian != 0x01020304u) {
+        std::cerr << "Warning: Not a particle-box delta trajectory file: " << filename << std::endl;
+        munmap(const_cast<unsigned char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+        return;
+    }
+
+    cursor_ = header_.header_bytes;
+
+    if (header_.index_offset > 0 && header_.index_offset <= size_ &&
+        header_.keyframe_count <= (size_ - header_.index_offset) / sizeof(DeltaKeyframeEntry)) {
+        size_t indexBytes = header_.keyframe_count * sizeof(DeltaKeyframeEntry);
+        end_ = header_.index_offset;
+        keyframes_.resize(header_.keyframe_count);
+        std::memcpy(keyframes_.data(), data_ + header_.index_offset, indexBytes);
+    } else {
+        // Writer did not finish: rebuild the keyframe index from the complete records
+        end_ = header_.header_bytes;
+        uint64_t frame = 0;
+        while (end_ < size_) {
+            const unsigned char* p = data_ + end_ + 1;
+            const unsigned char* limit = data_ + size_;
+            uint64_t step, bodyBytes;
+            if (!getVarint(p, limit, step) || !getVarint(p, limit, bodyBytes)) break;
+            if (bodyBytes > static_cast<uint64_t>(limit - p)) break;
+            if (data_[end_] == FRAME_KEY) {
+                keyframes_.push_back({frame, step, end_});
+            }
+            end_ = static_cast<size_t>(p - data_) + bodyBytes;
+            frame++;
+        }
+        header_.frame_count = frame;
+        header_.keyframe_count = keyframes_.size();
+    }
+}
+
+DeltaTrajectoryReader::~DeltaTrajectoryReader() {
+    if (data_) {
+        munmap(const_cast<unsigned char*>(data_), size_);
+    }
+}
+
+bool DeltaTrajectoryReader::seekKeyframe(size_t k) {
+    if (!data_ || k >= keyframes_.size()) return false;
+    cursor_ = keyframes_[k].offset;
+    havePrev_ = false;
+    return true;
+}
+
+bool DeltaTrajectoryReader::peekStep(size_t offset, uint64_t& step) const {
+    const unsigned char* p = data_ + offset + 1;
+    return offset < end_ && getVarint(p, data_ + end_, step);
+}
+
+bool DeltaTrajectoryReader::seekStep(uint64_t step) {
+    if (!data_ || keyframes_.empty()) return false;
+
+    auto it = std::upper_bound(keyframes_.begin(), keyframes_.end(), step,
+        [](uint64_t s, const DeltaKeyframeEntry& e) { return s < e.step; });
+    size_t k = (it == keyframes_.begin()) ? 0 : static_cast<size_t>(it - keyframes_.begin()) - 1;
+    seekKeyframe(k);
+
+    // Decode forward until the next frame is the requested one
+    DeltaFrame scratch;
+    uint64_t next;
+    while (peekStep(cursor_, next) && next < step) {
+        if (!readFrame(scratch)) return false;
+    }
+    return cursor_ < end_;
+}
+
+bool DeltaTrajectoryReader::readFrame(DeltaFrame& out) {
+    if (!data_ || cursor_ >= end_) return false;
+
+    const size_t N = header_.N;
+    const unsigned char* p = data_ + cursor_;
+    const unsigned char* limit = data_ + end_;
+    uint8_t type = *p++;
+    uint64_t step, bodyBytes;
+    if (!getVarint(p, limit, step) || !getVarint(p, limit, bodyBytes)) return false;
+    if (bodyBytes > static_cast<uint64_t>(limit - p)) return false;
+    const unsigned char* bodyEnd = p + bodyBytes;
+    // Every residual takes at least a byte: rejects a corrupt N before allocating for it
+    if (N > bodyBytes / COLUMNS) return false;
+
+    if (type == FRAME_DELTA && !havePrev_) {
+        std::cerr << "Warning: Delta frame without a preceding keyframe" << std::endl;
+        return false;
+    }
+
+    std::vector<int64_t> cur(COLUMNS * N);
+    for (int c = 0; c < COLUMNS; ++c) {
+        if (!decodeResiduals(p, bodyEnd, &cur[c * N], N)) return false;
+    }
+    if (type == FRAME_DELTA) {
+        for (size_t i = 0; i < N; ++i) {
+            for (int c = 0; c < COLUMNS; ++c) {
+                cur[c * N + i] += predict(prev_.data(), N, c, i);
+            }
+        }
+    }
+
+    size_t bitBytes = (N + 7) / 8;
+    if (static_cast<size_t>(bodyEnd - p) < bitBytes) return false;
+
+    out.step = step;
+    out.x.resize(N);
+    out.y.resize(N);
+    out.vx.resize(N);
+    out.vy.resize(N);
+    out.collided.assign(p, p + bitBytes);
+    for (size_t i = 0; i < N; ++i) {
+        out.x[i] = static_cast<float>(cur[0 * N + i] * header_.pos_quantum_x);
+        out.y[i] = static_cast<float>(cur[1 * N + i] * header_.pos_quantum_y);
+        out.vx[i] = static_cast<float>(cur[2 * N + i] * header_.vel_quantum_x);
+        out.vy[i] = static_cast<float>(cur[3 * N + i] * header_.vel_quantum_y);
+    }
+
+    prev_.swap(cur);
+    havePrev_ = true;
+    cursor_ = static_cast<size_t>(bodyEnd - data_);
+    return true;
+}
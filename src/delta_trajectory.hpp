@@ -0,0 +1,128 @@
+#pragma once
+
+#include "particle.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Delta-compressed trajectory file (steps.dtraj)
+//
+// Positions are quantized to fixed point against the box size
+// (q = box / 2^quant_bits) and velocities to q / dt, so the quantization error
+// is bounded by half a quantum in every component. Every keyframe_every-th
+// frame is a keyframe holding the absolute quantized values; the frames in
+// between hold residuals against a prediction from the previous frame
+// (x' = x + vx, v' = v in quantized units). Residuals are zigzag/varint coded
+// with zero runs collapsed, which makes steady motion cost about a byte per
+// particle per frame.
+//
+// Layout:
+//   [DeltaTrajectoryHeader]                          fixed 128 bytes
+//   frames: u8 type (0 key, 1 delta), varint step, varint body_bytes, body
+//     body: x, y, vx, vy token streams, then collided bitset (ceil(N/8) bytes)
+//   [DeltaKeyframeEntry x keyframe_count]            at index_offset
+
+struct DeltaTrajectoryHeader {
+    char magic[8];             // "PBDTRJ1\0"
+    uint32_t version;
+    uint32_t header_bytes;
+    uint64_t N;
+    double dt;
+    float box_w, box_h;
+    float radius;
+    uint32_t quant_bits;
+    uint64_t seed;
+    uint32_t keyframe_every;
+    uint32_t endian;           // 0x01020304 as written by the producer
+    double pos_quantum_x, pos_quantum_y;
+    double vel_quantum_x, vel_quantum_y;
+    uint64_t frame_count;
+    uint64_t keyframe_count;
+    uint64_t index_offset;
+    char reserved[8];
+};
+
+static_assert(sizeof(DeltaTrajectoryHeader) == 128, "DeltaTrajectoryHeader must stay 128 bytes");
+
+struct DeltaKeyframeEntry {
+    uint64_t frame;    // Frame number
+    uint64_t step;
+    uint64_t offset;   // Byte offset of the frame record
+};
+
+class DeltaTrajectoryWriter {
+public:
+    // append = true keeps an existing file for restoreState() instead of truncating it
+    DeltaTrajectoryWriter(const std::string& filename, int N, float dt, float box_w, float box_h,
+                          float radius, uint64_t seed, int keyframeEvery = 64, int quantBits = 20,
+                          bool append = false);
+    ~DeltaTrajectoryWriter();
+
+    void writeFrame(int step, const std::vector<Particle>& particles);
+    void close();  // Writes the keyframe index and patches the header
+    bool isOpen() const { return file_.is_open(); }
+    size_t memoryBytes() const {
+        return (prev_.capacity() + cur_.capacity()) * sizeof(int64_t) + body_.capacity() +
+               record_.capacity() + keyframes_.capacity() * sizeof(DeltaKeyframeEntry);
+    }
+    uint64_t frameCount() const { return frameCount_; }
+    uint64_t bytesWritten() const { return offset_; }
+    
+    // Checkpoint support: encoder position and prediction state / rewind to it
+    std::string saveState();
+    bool restoreState(const std::string& state);
+
+private:
+    std::string filename_;
+    std::fstream file_;
+    DeltaTrajectoryHeader header_;
+    std::vector<int64_t> prev_;     // Previous quantized frame, 4 columns of N
+    std::vector<int64_t> cur_;
+    std::vector<uint8_t> body_;
+    std::vector<uint8_t> record_;
+    std::vector<DeltaKeyframeEntry> keyframes_;
+    uint64_t frameCount_;
+    uint64_t offset_;
+};
+
+// Decoded frame with dequantized values
+struct DeltaFrame {
+    uint64_t step = 0;
+    std::vector<float> x, y, vx, vy;
+    std::vector<uint8_t> collided;  // Packed bitset
+
+    bool isCollided(size_t i) const { return (collided[i >> 3] >> (i & 7)) & 1u; }
+};
+
+// Memory-maps a steps.dtraj file; frames are decoded sequentially from any keyframe
+class DeltaTrajectoryReader {
+public:
+    explicit DeltaTrajectoryReader(const std::string& filename);
+    ~DeltaTrajectoryReader();
+
+    DeltaTrajectoryReader(const DeltaTrajectoryReader&) = delete;
+    DeltaTrajectoryReader& operator=(const DeltaTrajectoryReader&) = delete;
+
+    bool isOpen() const { return data_ != nullptr; }
+    const DeltaTrajectoryHeader& header() const { return header_; }
+    uint64_t frameCount() const { return header_.frame_count; }
+    const std::vector<DeltaKeyframeEntry>& keyframes() const { return keyframes_; }
+
+    bool seekKeyframe(size_t k);       // Next readFrame() returns keyframe k
+    bool seekStep(uint64_t step);      // Next readFrame() returns the first frame with step >= step
+    bool readFrame(DeltaFrame& out);   // Decodes the frame at the cursor and advances
+
+private:
+    DeltaTrajectoryHeader header_;
+    const unsigned char* data_;
+    size_t size_;
+    size_t cursor_;
+    size_t end_;                       // End of frame data
+    bool havePrev_;
+    std::vector<int64_t> prev_;
+    std::vector<DeltaKeyframeEntry> keyframes_;
+
+    bool peekStep(size_t offset, uint64_t& step) const;
+};
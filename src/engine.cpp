@@ -0,0 +1,88 @@
+#include "engine.hpp"
+#include "engine_quadtree.hpp"
+#include "engine_hash.hpp"
+#include "engine_auto.hpp"
+#include "engine_brute.hpp"
+#include "engine_event.hpp"
+
+std::unique_ptr<Engine> makeEngine(const std::string& method, float box_w, float box_h, float r,
+                                   const EngineParams& params) {
+    if (method == "quadtree") {
+        return std::make_unique<EngineQuadtree>(box_w, box_h, r, params);
+    }
+    if (method == "hash") {
+        return std::make_unique<EngineHash>(box_w, box_h, r, params);
+    }
+    if (method == "brute") {
+        return std::make_unique<EngineBrute>(box_w, box_h, r, params);
+    }
+    if (method == "event") {
+        return std::make_unique<EngineEvent>(box_w, box_h, r, params);
+    }
+    if (method == "auto") {
+        return std::make_unique<EngineAuto>(box_w, box_h, r, params);
+    }
+    return nullptr;
+}
+
+void Engine::stepSwept(std::vector<Particle>& particles, float dt, float box_w, float box_h,
+                       const std::function<void()>& clear, const std::function<void(const BodyRef&)>& insert,
+                       const SweptQuery& query) {
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Integrate);
+        for (auto& p : particles) {
+            p.collided = false;
+        }
+    }
+    
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Build);
+        clear();
+        for (const auto& p : particles) {
+            insert(ccd::sweptBounds(p, dt));
+        }
+    }
+    
+    captureBuild(particles);
+    
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Narrow);
+        idToIndex_.resize(particles.size());
+        for (size_t i = 0; i < particles.size(); ++i) {
+            idToIndex_[particles[i].id] = i;
+        }
+        swept_.clear();
+        for (size_t i = 0; i < particles.size(); ++i) {
+            const auto& p = particles[i];
+            float minX, minY, maxX, maxY;
+            ccd::sweptBox(p, dt, minX, minY, maxX, maxY);
+            query(minX, minY, maxX, maxY, candidates_);
+            candidatePairsChecked_ += candidates_.size();
+            for (int j_id : candidates_) {
+                captureCandidate(p.id, j_id);
+                if (j_id > p.id && j_id < static_cast<int>(particles.size())) {
+                    swept_.addPair(static_cast<int>(i), idToIndex_[j_id]);
+                }
+            }
+        }
+        // A bounced body's new path goes into the structure next to its old one
+        const int n = static_cast<int>(particles.size());
+        auto reroute = [&](const BodyRef& bounds, float minX, float minY, float maxX, float maxY,
+                           std::vector<int>& out) {
+            insert(bounds);
+            query(minX, minY, maxX, maxY, candidates_);
+            candidatePairsChecked_ += candidates_.size();
+            out.clear();
+            for (int j_id : candidates_) {
+                if (j_id >= 0 && j_id < n) out.push_back(idToIndex_[j_id]);
+            }
+        };
+        swept_.solve(particles, dt, box_w, box_h, energyOut(), pairLog_, reroute);
+        collisionsThisStep_ = swept_.collisions();
+    }
+}
+
+const std::vector<std::string>& engineNames() {
+    static const std::vector<std::string> names = {"quadtree", "hash"};
+    return names;
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "particle.hpp"
+#include "physics.hpp"
+#include "pair_log.hpp"
+#include "phase_timer.hpp"
+#include "broadphase_stats.hpp"
+#include "ccd.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Broad-phase parameters (--autotune); each engine reads its own fields
+struct EngineParams {
+    int quadtreeCap = 8;          // Bodies per leaf before it splits
+    int quadtreeMaxDepth = 12;
+    float hashCellScale = 2.0f;   // Cell size in radii; >= 2 so the 3x3 query reaches 2r
+    int hashTableSize = 256;      // Initial slots
+    float hashMaxLoad = 0.75f;    // Occupied-slot fraction that triggers a resize
+    int autoProbeEvery = 100;     // --method auto: steps between cost probes of the other engines
+    int threads = 0;              // --method brute: worker threads, 0 = one per core
+    bool ccd = false;             // quadtree/hash: swept-circle collisions (--ccd)
+};
+
+// One step of broad-phase output (--verify_broadphase): the positions the
+// structure was built from, and every pair its queries returned
+struct CandidateCapture {
+    std::vector<Particle> positions;
+    std::vector<std::pair<int, int>> pairs;   // Ids, first < second; may repeat
+};
+
+// Common interface of the broad-phase engines
+class Engine {
+public:
+    virtual ~Engine() = default;
+    
+    virtual void step(std::vector<Particle>& particles, float dt) = 0;
+    
+    // Parameters the engine was built with, and the ones it uses as text
+    // (e.g. "cap=8 max_depth=12"; empty for engines without any)
+    const EngineParams& params() const { return params_; }
+    virtual std::string describeParams() const { return ""; }
+    
+    // Non-empty after a step in which the engine changed strategy (EngineAuto
+    // switching broad phase): why it did. describeParams() tells what to.
+    const std::string& switchNote() const { return switchNote_; }
+    
+    // Internal state beyond the particles, for checkpoints (empty if none)
+    virtual std::string saveState() const { return ""; }
+    virtual bool loadState(const std::string& state) { return state.empty(); }
+    
+    // Metrics
+    int getCandidatePairsChecked() const { return candidatePairsChecked_; }
+    int getCollisionsThisStep() const { return collisionsThisStep_; }
+    void resetMetrics() { candidatePairsChecked_ = 0; collisionsThisStep_ = 0; }
+    const PhaseTimes& getPhaseTimes() const { return phaseTimes_; }  // Last step
+    // Kinetic energy and momentum after the last step, when tracking is on
+    const physics::StepEnergy& getStepEnergy() const { return energy_; }
+    void setEnergyTracking(bool on) { trackEnergy_ = on; }
+    // Heap bytes held between steps: broad-phase structure and narrow-phase scratch
+    virtual size_t broadphaseBytes() const { return 0; }
+    virtual size_t scratchBytes() const {
+        return idToIndex_.capacity() * sizeof(int) + candidates_.capacity() * sizeof(int) +
+               processedPairs_.capacity() * sizeof(std::pair<int, int>) + swept_.memoryBytes();
+    }
+    
+    // Structure built by the last step; Kind::None for engines without one
+    virtual void collectBroadphaseStats(BroadphaseStats& out) const { out = BroadphaseStats(); }
+    
+    // Candidate pairs are appended here when set (--log_pairs)
+    void setPairLog(PairLog* log) { pairLog_ = log; }
+    // Hardware counters read around every phase when set (--perf_counters)
+    void setPerfCounters(PerfCounters* perf) { phaseTimes_.perf = perf; }
+    // Build positions and candidate pairs of the next steps go here when set
+    void setCandidateCapture(CandidateCapture* capture) { capture_ = capture; }
+    
+protected:
+    explicit Engine(const EngineParams& params = EngineParams()) : params_(params) {}
+    
+    EngineParams params_;
+    int candidatePairsChecked_ = 0;
+    int collisionsThisStep_ = 0;
+    PairLog* pairLog_ = nullptr;
+    PhaseTimes phaseTimes_;
+    physics::StepEnergy energy_;
+    bool trackEnergy_ = false;
+    std::string switchNote_;
+    CandidateCapture* capture_ = nullptr;
+    
+    // Narrow-phase scratch, kept across steps so it is allocated once
+    std::vector<int> idToIndex_;
+    std::vector<int> candidates_;
+    std::vector<std::pair<int, int>> processedPairs_;
+    ccd::Solver swept_;   // --ccd
+    
+    physics::StepEnergy* energyOut() {
+        return trackEnergy_ ? &energy_ : nullptr;
+    }
+    
+    // Called after the build phase and for every candidate the queries return
+    void captureBuild(const std::vector<Particle>& particles) {
+        if (!capture_) return;
+        capture_->positions = particles;
+        capture_->pairs.clear();
+    }
+    void captureCandidate(int a, int b) {
+        if (capture_ && a != b) capture_->pairs.emplace_back(std::min(a, b), std::max(a, b));
+    }
+    
+    // One --ccd step of a broad-phase engine: clear() and insert() rebuild
+    // its structure from the bounding circles of the particles' paths,
+    // query() returns the ids whose circles meet a path's bounding box, and
+    // swept_ moves the particles through dt in time-of-impact order, filing
+    // and querying the new path of every body that bounces
+    using SweptQuery = std::function<void(float, float, float, float, std::vector<int>&)>;
+    void stepSwept(std::vector<Particle>& particles, float dt, float box_w, float box_h,
+                   const std::function<void()>& clear, const std::function<void(const BodyRef&)>& insert,
+                   const SweptQuery& query);
+};
+
+// Engine for --method, or nullptr if the name is unknown
+std::unique_ptr<Engine> makeEngine(const std::string& method, float box_w, float box_h, float r,
+                                   const EngineParams& params = EngineParams());
+
+// The broad-phase engines "auto" picks among and --scaling compares. makeEngine
+// also accepts "auto", the O(N^2) reference "brute" and the event-driven
+// "event", which does not step the same physics.
+const std::vector<std::string>& engineNames();
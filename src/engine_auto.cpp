@@ -0,0 +1,172 @@
+#include "engine_auto.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+constexpr double kSmoothing = 0.2;          // Weight of the newest sample in costNs
+constexpr double kHysteresis = 0.15;        // Required predicted saving to switch
+constexpr int kConfirmProbes = 2;
+constexpr int kMinDwellIntervals = 2;       // Probe intervals before the next switch
+constexpr double kCandidateDrift = 0.3;     // Relative change that triggers early probes
+constexpr int kMaxBackoff = 16;             // Longest probe interval, in autoProbeEvery units
+constexpr long kMinProbeGap = 10;
+
+}
+
+EngineAuto::EngineAuto(float box_w, float box_h, float r, const EngineParams& params)
+    : Engine(params) {
+    for (const auto& method : engineNames()) {
+        Candidate c;
+        c.method = method;
+        c.engine = makeEngine(method, box_w, box_h, r, params);
+        c.probeInterval = std::max(params.autoProbeEvery, 1);
+        c.nextProbe = 1;  // Everyone gets measured after the first step
+        candidates_.push_back(std::move(c));
+    }
+}
+
+double EngineAuto::broadphaseCostNs(const Engine& engine, size_t N) {
+    const PhaseTimes& times = engine.getPhaseTimes();
+    return (times[Phase::Build] + times[Phase::Narrow]) * 1e6 / std::max<size_t>(N, 1);
+}
+
+void EngineAuto::probe(Candidate& c, const std::vector<Particle>& particles, float dt) {
+    trace::Scope probeScope("auto_probe", "engine");
+    probeParticles_ = particles;
+    c.engine->setPairLog(nullptr);
+    c.engine->setPerfCounters(nullptr);
+    c.engine->setEnergyTracking(false);
+    c.engine->setCandidateCapture(nullptr);
+    c.engine->step(probeParticles_, dt);
+    double cost = broadphaseCostNs(*c.engine, particles.size());
+    c.costNs = c.costNs > 0.0 ? (1.0 - kSmoothing) * c.costNs + kSmoothing * cost : cost;
+
+    // Back off from engines that are clearly slower here
+    const Candidate& current = candidates_[active_];
+    int base = std::max(params_.autoProbeEvery, 1);
+    if (current.costNs > 0.0 && c.costNs > 2.0 * current.costNs) {
+        c.probeInterval = std::min(c.probeInterval * 2, base * kMaxBackoff);
+    } else {
+        c.probeInterval = base;
+    }
+    c.nextProbe = steps_ + c.probeInterval;
+    c.betterProbes = (current.costNs > 0.0 && c.costNs < (1.0 - kHysteresis) * current.costNs)
+                         ? c.betterProbes + 1 : 0;
+}
+
+void EngineAuto::maybeSwitch() {
+    if (steps_ - activeSince_ < static_cast<long>(kMinDwellIntervals) * std::max(params_.autoProbeEvery, 1)) {
+        return;
+    }
+    size_t best = active_;
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+        const Candidate& c = candidates_[i];
+        if (i != active_ && c.betterProbes >= kConfirmProbes && c.costNs < candidates_[best].costNs) {
+            best = i;
+        }
+    }
+    if (best == active_) return;
+
+    char note[160];
+    std::snprintf(note, sizeof(note), "predicted %.1f vs %.1f ns/particle for %s",
+                  candidates_[best].costNs, candidates_[active_].costNs, candidates_[active_].method.c_str());
+    switchNote_ = note;
+    active_ = best;
+    activeSince_ = steps_;
+    for (auto& c : candidates_) c.betterProbes = 0;
+}
+
+void EngineAuto::step(std::vector<Particle>& particles, float dt) {
+    switchNote_.clear();
+
+    // Probe the other engines when due, or early when the scene has changed
+    bool drifted = candPerParticleAtProbe_ > 0.0 && steps_ - lastProbe_ >= kMinProbeGap &&
+                   std::abs(static_cast<double>(candidatePairsChecked_) / std::max<size_t>(particles.size(), 1) -
+                            candPerParticleAtProbe_) > kCandidateDrift * candPerParticleAtProbe_;
+    bool probed = false;
+    for (size_t i = 0; i < candidates_.size(); ++i) {
+        Candidate& c = candidates_[i];
+        if (i != active_ && steps_ > 0 && (steps_ >= c.nextProbe || drifted)) {
+            probe(c, particles, dt);
+            probed = true;
+        }
+    }
+    if (probed) {
+        lastProbe_ = steps_;
+        candPerParticleAtProbe_ = static_cast<double>(candidatePairsChecked_) / std::max<size_t>(particles.size(), 1);
+        maybeSwitch();
+    }
+
+    // The real step, with this engine's settings passed through
+    Candidate& current = candidates_[active_];
+    current.engine->setPairLog(pairLog_);
+    current.engine->setPerfCounters(phaseTimes_.perf);
+    current.engine->setEnergyTracking(trackEnergy_);
+    current.engine->setCandidateCapture(capture_);
+    current.engine->step(particles, dt);
+
+    double cost = broadphaseCostNs(*current.engine, particles.size());
+    current.costNs = current.costNs > 0.0 ? (1.0 - kSmoothing) * current.costNs + kSmoothing * cost : cost;
+    candidatePairsChecked_ = current.engine->getCandidatePairsChecked();
+    collisionsThisStep_ = current.engine->getCollisionsThisStep();
+    PerfCounters* perf = phaseTimes_.perf;
+    phaseTimes_ = current.engine->getPhaseTimes();
+    phaseTimes_.perf = perf;
+    energy_ = current.engine->getStepEnergy();
+    if (candPerParticleAtProbe_ == 0.0) {
+        candPerParticleAtProbe_ = static_cast<double>(candidatePairsChecked_) / std::max<size_t>(particles.size(), 1);
+    }
+    steps_++;
+}
+
+std::string EngineAuto::describeParams() const {
+    std::string inner = candidates_[active_].engine->describeParams();
+    return "active=" + candidates_[active_].method + (inner.empty() ? "" : " " + inner);
+}
+
+size_t EngineAuto::broadphaseBytes() const {
+    size_t bytes = 0;
+    for (const auto& c : candidates_) bytes += c.engine->broadphaseBytes();
+    return bytes;
+}
+
+size_t EngineAuto::scratchBytes() const {
+    size_t bytes = probeParticles_.capacity() * sizeof(Particle);
+    for (const auto& c : candidates_) bytes += c.engine->scratchBytes();
+    return bytes;
+}
+
+void EngineAuto::collectBroadphaseStats(BroadphaseStats& out) const {
+    candidates_[active_].engine->collectBroadphaseStats(out);
+}
+
+// Text: active index, counters, then per candidate its method and estimates
+std::string EngineAuto::saveState() const {
+    std::ostringstream os;
+    os.precision(17);
+    os << active_ << ' ' << steps_ << ' ' << activeSince_ << ' ' << lastProbe_ << ' '
+       << candPerParticleAtProbe_ << ' ' << candidates_.size();
+    for (const auto& c : candidates_) {
+        os << ' ' << c.method << ' ' << c.costNs << ' ' << c.betterProbes << ' '
+           << c.probeInterval << ' ' << c.nextProbe;
+    }
+    return os.str();
+}
+
+bool EngineAuto::loadState(const std::string& state) {
+    std::istringstream is(state);
+    size_t active = 0, count = 0;
+    is >> active >> steps_ >> activeSince_ >> lastProbe_ >> candPerParticleAtProbe_ >> count;
+    if (!is || count != candidates_.size() || active >= count) return false;
+    for (auto& c : candidates_) {
+        std::string method;
+        is >> method >> c.costNs >> c.betterProbes >> c.probeInterval >> c.nextProbe;
+        if (!is || method != c.method) return false;
+    }
+    active_ = active;
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "engine.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+// --method auto: runs one of the concrete engines (engineNames()) and moves
+// to another when it is predicted to be faster.
+//
+// The prediction is each engine's broad-phase cost (build + narrow phase ms
+// per particle), smoothed over steps. The active engine measures itself on
+// every step. The others are probed: every autoProbeEvery steps, or earlier
+// when candidates per particle have drifted by 30% since the last probe, each
+// one steps a copy of the particles once. Engines that probe more than twice
+// as slow as the active one back off to probing less and less often.
+//
+// Hysteresis: a switch needs the other engine's estimate to be 15% below the
+// active one on two consecutive probes, and the active engine to have run for
+// at least two probe intervals. Probe steps are part of the step time.
+class EngineAuto : public Engine {
+public:
+    EngineAuto(float box_w, float box_h, float r, const EngineParams& params = EngineParams());
+
+    void step(std::vector<Particle>& particles, float dt) override;
+    std::string describeParams() const override;
+    size_t broadphaseBytes() const override;
+    size_t scratchBytes() const override;
+    void collectBroadphaseStats(BroadphaseStats& out) const override;
+
+    std::string saveState() const override;
+    bool loadState(const std::string& state) override;
+
+    const std::string& activeMethod() const { return candidates_[active_].method; }
+
+private:
+    struct Candidate {
+        std::string method;
+        std::unique_ptr<Engine> engine;
+        double costNs = 0.0;         // Smoothed build + narrow ns per particle; 0 = not measured yet
+        int betterProbes = 0;        // Consecutive probes clearly faster than the active engine
+        int probeInterval = 0;       // Steps between probes, grows while clearly slower
+        long nextProbe = 0;          // Step count at which to probe next
+    };
+
+    std::vector<Candidate> candidates_;
+    size_t active_ = 0;
+    long steps_ = 0;                  // Steps taken by this engine
+    long activeSince_ = 0;
+    long lastProbe_ = 0;
+    double candPerParticleAtProbe_ = 0.0;
+    std::vector<Particle> probeParticles_;
+
+    void probe(Candidate& c, const std::vector<Particle>& particles, float dt);
+    void maybeSwitch();
+    static double broadphaseCostNs(const Engine& engine, size_t N);
+};
@@ -0,0 +1,142 @@
+#include "engine_brute.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr int kRowsPerBlock = 64;
+constexpr size_t kMinParallelN = 2048;   // Below this, starting threads costs more than it saves
+
+// Pairs (i, j > i) of one row; same arithmetic as physics::circle_overlap
+void scanRow(const float* xs, const float* ys, const float* rs, int i, int n,
+             std::vector<std::pair<int, int>>& out) {
+    const float xi = xs[i], yi = ys[i], ri = rs[i];
+    int j = i + 1;
+#if defined(__SSE2__)
+    const __m128 vxi = _mm_set1_ps(xi);
+    const __m128 vyi = _mm_set1_ps(yi);
+    const __m128 vri = _mm_set1_ps(ri);
+    for (; j + 4 <= n; j += 4) {
+        __m128 dx = _mm_sub_ps(vxi, _mm_loadu_ps(xs + j));
+        __m128 dy = _mm_sub_ps(vyi, _mm_loadu_ps(ys + j));
+        __m128 distSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 rSum = _mm_add_ps(vri, _mm_loadu_ps(rs + j));
+        int mask = _mm_movemask_ps(_mm_cmplt_ps(distSq, _mm_mul_ps(rSum, rSum)));
+        while (mask) {
+            out.emplace_back(i, j + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; j < n; ++j) {
+        float dx = xi - xs[j];
+        float dy = yi - ys[j];
+        float rSum = ri + rs[j];
+        if (dx * dx + dy * dy < rSum * rSum) {
+            out.emplace_back(i, j);
+        }
+    }
+}
+
+}
+
+void bruteForcePairs(const std::vector<Particle>& particles, int threads,
+                     std::vector<std::pair<int, int>>& out) {
+    out.clear();
+    const int n = static_cast<int>(particles.size());
+    if (n < 2) return;
+
+    std::vector<float> xs(n), ys(n), rs(n);
+    for (int i = 0; i < n; ++i) {
+        xs[i] = particles[i].x;
+        ys[i] = particles[i].y;
+        rs[i] = particles[i].r;
+    }
+
+    if (particles.size() < kMinParallelN || resolveThreads(threads) == 1) {
+        for (int i = 0; i < n; ++i) scanRow(xs.data(), ys.data(), rs.data(), i, n, out);
+        return;
+    }
+
+    // Blocks go to whichever thread is free (early rows are the longest) and
+    // are concatenated in row order afterwards
+    const int blocks = (n + kRowsPerBlock - 1) / kRowsPerBlock;
+    std::vector<std::vector<std::pair<int, int>>> blockPairs(blocks);
+    parallelFor(blocks, threads, [&](int b) {
+        int end = std::min(n, (b + 1) * kRowsPerBlock);
+        for (int i = b * kRowsPerBlock; i < end; ++i) {
+            scanRow(xs.data(), ys.data(), rs.data(), i, n, blockPairs[b]);
+        }
+    });
+
+    for (const auto& pairs : blockPairs) {
+        out.insert(out.end(), pairs.begin(), pairs.end());
+    }
+}
+
+EngineBrute::EngineBrute(float box_w, float box_h, float r, const EngineParams& params)
+    : Engine(params), box_w_(box_w), box_h_(box_h), r_(r) {
+}
+
+std::string EngineBrute::describeParams() const {
+    return "threads=" + std::to_string(params_.threads);
+}
+
+void EngineBrute::step(std::vector<Particle>& particles, float dt) {
+    candidatePairsChecked_ = 0;
+    collisionsThisStep_ = 0;
+    phaseTimes_.clear();
+    energy_.reset();
+
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Integrate);
+        for (auto& p : particles) {
+            p.collided = false;
+        }
+        physics::integrate(particles, dt);
+    }
+
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Walls);
+        physics::handle_walls(particles, box_w_, box_h_, r_, energyOut());
+    }
+
+    // All-pairs test stands in for building a structure
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Build);
+        bruteForcePairs(particles, params_.threads, pairs_);
+    }
+
+    if (capture_) {
+        captureBuild(particles);
+        for (const auto& pair : pairs_) {
+            captureCandidate(particles[pair.first].id, particles[pair.second].id);
+        }
+    }
+
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Narrow);
+        narrowPhase(particles);
+    }
+}
+
+void EngineBrute::narrowPhase(std::vector<Particle>& particles) {
+    candidatePairsChecked_ = static_cast<int>(2 * pairs_.size());
+
+    for (const auto& pair : pairs_) {
+        auto& p = particles[pair.first];
+        auto& other = particles[pair.second];
+
+        // Earlier corrections this step may have separated them
+        bool overlap = physics::circle_overlap(p, other);
+        if (pairLog_) pairLog_->record(std::min(p.id, other.id), std::max(p.id, other.id), true, overlap);
+        if (overlap) {
+            physics::resolve_collision(p, other, energyOut());
+            physics::positional_correction(p, other);
+            collisionsThisStep_++;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "particle.hpp"
+#include "physics.hpp"
+#include "engine.hpp"
+#include <utility>
+#include <vector>
+
+// Every pair that physics::circle_overlap reports, as indices i < j in
+// ascending order, from testing all N(N-1)/2 pairs. Rows are shared out in
+// blocks over `threads` threads (0 = one per core) and the inner loop tests
+// four pairs at a time with SSE2 where available. The result, including its
+// order, does not depend on the thread count.
+void bruteForcePairs(const std::vector<Particle>& particles, int threads,
+                     std::vector<std::pair<int, int>>& out);
+
+// --method brute: O(N^2) reference engine. The build phase is
+// bruteForcePairs() on the post-wall positions, the narrow phase resolves
+// those pairs in order (re-testing each, as positions move during
+// resolution). It reports the pairs it found, counted once per particle, as
+// its candidates, so its cand_per_particle is what an exact broad phase gets.
+class EngineBrute : public Engine {
+public:
+    EngineBrute(float box_w, float box_h, float r, const EngineParams& params = EngineParams());
+
+    void step(std::vector<Particle>& particles, float dt) override;
+    std::string describeParams() const override;
+    size_t scratchBytes() const override { return pairs_.capacity() * sizeof(std::pair<int, int>); }
+
+private:
+    float box_w_, box_h_, r_;
+    std::vector<std::pair<int, int>> pairs_;   // Overlapping pairs of this step, as indices
+
+    void narrowPhase(std::vector<Particle>& particles);
+};
@@ -0,0 +1,384 @@
+#include "engine_event.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+constexpr double kNever = std::numeric_limits<double>::infinity();
+constexpr double kCellSlack = 1.0 + 1e-9;   // Keeps cells at least a diameter after rounding
+constexpr size_t kMaxCellsPerBody = 4;      // Dilute boxes get fewer, larger cells
+
+}
+
+EngineEvent::EngineEvent(float box_w, float box_h, float /*r*/, const EngineParams& params)
+    : Engine(params), box_w_(box_w), box_h_(box_h) {
+}
+
+std::string EngineEvent::describeParams() const {
+    if (cellsX_ == 0) return "";
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "cells=%dx%d", cellsX_, cellsY_);
+    return buf;
+}
+
+size_t EngineEvent::broadphaseBytes() const {
+    return (head_.capacity() + next_.capacity() + prev_.capacity()) * sizeof(int);
+}
+
+size_t EngineEvent::scratchBytes() const {
+    return slots_.capacity() * sizeof(Slot) + collided_.capacity() +
+           (heap_.capacity() + heapPos_.capacity()) * sizeof(int);
+}
+
+void EngineEvent::step(std::vector<Particle>& particles, float dt) {
+    candidatePairsChecked_ = 0;
+    collisionsThisStep_ = 0;
+    phaseTimes_.clear();
+    energy_.reset();
+
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Build);
+        if (!matches(particles)) {
+            rebuild(particles);
+        }
+        std::fill(collided_.begin(), collided_.end(), 0);
+    }
+
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Narrow);
+        const double end = time_ + dt;
+        while (!heap_.empty()) {
+            const int i = heap_[0];
+            const Event e = slots_[i].event;
+            if (e.time > end) break;
+            time_ = std::max(time_, e.time);
+
+            Slot& s = slots_[i];
+            switch (e.type) {
+            case EventType::Pair:
+                // Stale if the partner has changed velocity since
+                if (slots_[e.partner].count == e.partnerCount) {
+                    collide(i, e.partner);
+                    predict(e.partner);
+                    update(e.partner);
+                }
+                break;
+            case EventType::WallX:
+                advance(i);
+                s.body.x = s.body.vx > 0.0 ? box_w_ - s.body.r : s.body.r;
+                s.body.vx = -s.body.vx;
+                s.count++;
+                s.lastPartner = -1;
+                collided_[i] = 1;
+                break;
+            case EventType::WallY:
+                advance(i);
+                s.body.y = s.body.vy > 0.0 ? box_h_ - s.body.r : s.body.r;
+                s.body.vy = -s.body.vy;
+                s.count++;
+                s.lastPartner = -1;
+                collided_[i] = 1;
+                break;
+            case EventType::CellX:
+                advance(i);
+                unlink(i);
+                s.cellX += s.body.vx > 0.0 ? 1 : -1;
+                link(i);
+                break;
+            case EventType::CellY:
+                advance(i);
+                unlink(i);
+                s.cellY += s.body.vy > 0.0 ? 1 : -1;
+                link(i);
+                break;
+            case EventType::None:
+                break;
+            }
+            predict(i);
+            update(i);
+        }
+        time_ = end;
+    }
+
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Integrate);
+        output(particles);
+    }
+
+    if (capture_) {
+        captureContacts(particles);
+    }
+}
+
+bool EngineEvent::matches(const std::vector<Particle>& particles) const {
+    if (particles.size() != slots_.size() || cellsX_ == 0) return false;
+    for (size_t i = 0; i < particles.size(); ++i) {
+        const Body& b = slots_[i].body;
+        const Particle& p = particles[i];
+        double dt = time_ - b.t;
+        if (p.x != static_cast<float>(b.x + b.vx * dt) || p.y != static_cast<float>(b.y + b.vy * dt) ||
+            p.vx != static_cast<float>(b.vx) || p.vy != static_cast<float>(b.vy) ||
+            p.r != b.r || p.id != b.id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void EngineEvent::output(std::vector<Particle>& particles) {
+    physics::StepEnergy* energy = energyOut();
+    for (size_t i = 0; i < particles.size(); ++i) {
+        const Body& b = slots_[i].body;
+        Particle& p = particles[i];
+        double dt = time_ - b.t;
+        p.x = static_cast<float>(b.x + b.vx * dt);
+        p.y = static_cast<float>(b.y + b.vy * dt);
+        p.vx = static_cast<float>(b.vx);
+        p.vy = static_cast<float>(b.vy);
+        p.collided = collided_[i] != 0;
+        if (energy) {
+            double vx = p.vx;
+            double vy = p.vy;
+            energy->kinetic.add(0.5 * (vx * vx + vy * vy));
+            energy->momentumX.add(vx);
+            energy->momentumY.add(vy);
+        }
+    }
+}
+
+void EngineEvent::rebuild(const std::vector<Particle>& particles) {
+    const int n = static_cast<int>(particles.size());
+    time_ = 0.0;
+    slots_.resize(n);
+    for (int i = 0; i < n; ++i) {
+        const Particle& p = particles[i];
+        Slot& s = slots_[i];
+        s.body = {p.x, p.y, p.vx, p.vy, 0.0, p.r, p.id};
+        s.event = {kNever, EventType::None, -1, 0};
+        s.count = 0;
+        s.lastPartner = -1;
+        s.cellX = -1;   // Assigned from the position by buildGrid()
+    }
+    buildGrid();
+
+    for (int i = 0; i < n; ++i) predict(i);
+    heap_.resize(n);
+    heapPos_.resize(n);
+    for (int i = 0; i < n; ++i) {
+        heap_[i] = i;
+        heapPos_[i] = i;
+    }
+    for (int pos = n / 2 - 1; pos >= 0; --pos) siftDown(pos);
+    collided_.assign(n, 0);
+}
+
+void EngineEvent::buildGrid() {
+    const size_t n = slots_.size();
+    float maxR = 0.0f;
+    for (const auto& s : slots_) maxR = std::max(maxR, s.body.r);
+
+    double diameter = std::max(2.0 * maxR * kCellSlack, 1e-6);
+    cellsX_ = std::max(1, static_cast<int>(box_w_ / diameter));
+    cellsY_ = std::max(1, static_cast<int>(box_h_ / diameter));
+    size_t maxCells = std::max<size_t>(kMaxCellsPerBody * n, 1);
+    size_t cells = static_cast<size_t>(cellsX_) * cellsY_;
+    if (cells > maxCells) {
+        double shrink = std::sqrt(static_cast<double>(cells) / maxCells);
+        cellsX_ = std::max(1, static_cast<int>(cellsX_ / shrink));
+        cellsY_ = std::max(1, static_cast<int>(cellsY_ / shrink));
+    }
+    cellW_ = static_cast<double>(box_w_) / cellsX_;
+    cellH_ = static_cast<double>(box_h_) / cellsY_;
+
+    head_.assign(static_cast<size_t>(cellsX_) * cellsY_, -1);
+    next_.assign(n, -1);
+    prev_.assign(n, -1);
+    for (size_t i = 0; i < n; ++i) {
+        Slot& s = slots_[i];
+        if (s.cellX < 0) {
+            s.cellX = std::min(std::max(static_cast<int>(std::floor(s.body.x / cellW_)), 0), cellsX_ - 1);
+            s.cellY = std::min(std::max(static_cast<int>(std::floor(s.body.y / cellH_)), 0), cellsY_ - 1);
+        }
+        link(static_cast<int>(i));
+    }
+}
+
+void EngineEvent::link(int i) {
+    int c = cellIndex(slots_[i]);
+    prev_[i] = -1;
+    next_[i] = head_[c];
+    if (head_[c] >= 0) prev_[head_[c]] = i;
+    head_[c] = i;
+}
+
+void EngineEvent::unlink(int i) {
+    if (prev_[i] >= 0) next_[prev_[i]] = next_[i];
+    else head_[cellIndex(slots_[i])] = next_[i];
+    if (next_[i] >= 0) prev_[next_[i]] = prev_[i];
+}
+
+void EngineEvent::advance(int i) {
+    Body& b = slots_[i].body;
+    double dt = time_ - b.t;
+    b.x += b.vx * dt;
+    b.y += b.vy * dt;
+    b.t = time_;
+}
+
+// Earliest of: wall contact, leaving the cell, contact with a body of the 3x3
+// neighbourhood (cells are a diameter wide, so nothing further away can be
+// reached without a cell crossing first)
+void EngineEvent::predict(int i) {
+    advance(i);
+    Slot& s = slots_[i];
+    const Body& b = s.body;
+    Event best = {kNever, EventType::None, -1, 0};
+    auto consider = [&](double dt, EventType type) {
+        double t = time_ + std::max(dt, 0.0);
+        if (t < best.time) best = {t, type, -1, 0};
+    };
+
+    if (b.vx > 0.0) consider((box_w_ - b.r - b.x) / b.vx, EventType::WallX);
+    if (b.vx < 0.0) consider((b.r - b.x) / b.vx, EventType::WallX);
+    if (b.vy > 0.0) consider((box_h_ - b.r - b.y) / b.vy, EventType::WallY);
+    if (b.vy < 0.0) consider((b.r - b.y) / b.vy, EventType::WallY);
+    if (b.vx > 0.0 && s.cellX < cellsX_ - 1) consider(((s.cellX + 1) * cellW_ - b.x) / b.vx, EventType::CellX);
+    if (b.vx < 0.0 && s.cellX > 0) consider((s.cellX * cellW_ - b.x) / b.vx, EventType::CellX);
+    if (b.vy > 0.0 && s.cellY < cellsY_ - 1) consider(((s.cellY + 1) * cellH_ - b.y) / b.vy, EventType::CellY);
+    if (b.vy < 0.0 && s.cellY > 0) consider((s.cellY * cellH_ - b.y) / b.vy, EventType::CellY);
+
+    for (int cy = std::max(s.cellY - 1, 0); cy <= std::min(s.cellY + 1, cellsY_ - 1); ++cy) {
+        for (int cx = std::max(s.cellX - 1, 0); cx <= std::min(s.cellX + 1, cellsX_ - 1); ++cx) {
+            for (int k = head_[cy * cellsX_ + cx]; k >= 0; k = next_[k]) {
+                // A pair that just bounced off each other cannot meet again
+                // before one of them hits something else
+                if (k == i || (s.lastPartner == k && slots_[k].lastPartner == i)) continue;
+                candidatePairsChecked_++;
+                const Body& o = slots_[k].body;
+                double dt = time_ - o.t;
+                double tau = physics::contact_time(o.x + o.vx * dt - b.x, o.y + o.vy * dt - b.y,
+                                                   o.vx - b.vx, o.vy - b.vy, static_cast<double>(b.r) + o.r);
+                double t = time_ + tau;
+                // Ties go to the lower index so the result does not depend on list order
+                if (t < best.time || (t == best.time && best.type == EventType::Pair && k < best.partner)) {
+                    best = {t, EventType::Pair, k, slots_[k].count};
+                }
+            }
+        }
+    }
+    s.event = best;
+}
+
+void EngineEvent::collide(int i, int j) {
+    advance(i);
+    advance(j);
+    Slot& si = slots_[i];
+    Slot& sj = slots_[j];
+    Body& a = si.body;
+    Body& b = sj.body;
+    physics::elastic_bounce(b.x - a.x, b.y - a.y, a.vx, a.vy, b.vx, b.vy);
+
+    si.count++;
+    sj.count++;
+    si.lastPartner = j;
+    sj.lastPartner = i;
+    collided_[i] = 1;
+    collided_[j] = 1;
+    collisionsThisStep_++;
+    if (pairLog_) pairLog_->record(std::min(a.id, b.id), std::max(a.id, b.id), true, true);
+}
+
+// Pairs of the grid neighbourhood that overlap at the written positions
+// (there should be none) as candidates, for --verify_broadphase
+void EngineEvent::captureContacts(const std::vector<Particle>& particles) {
+    captureBuild(particles);
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        const Slot& s = slots_[i];
+        for (int cy = std::max(s.cellY - 1, 0); cy <= std::min(s.cellY + 1, cellsY_ - 1); ++cy) {
+            for (int cx = std::max(s.cellX - 1, 0); cx <= std::min(s.cellX + 1, cellsX_ - 1); ++cx) {
+                for (int k = head_[cy * cellsX_ + cx]; k >= 0; k = next_[k]) {
+                    if (static_cast<size_t>(k) > i && physics::circle_overlap(particles[i], particles[k])) {
+                        captureCandidate(particles[i].id, particles[k].id);
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool EngineEvent::before(int a, int b) const {
+    double ta = slots_[a].event.time;
+    double tb = slots_[b].event.time;
+    return ta < tb || (ta == tb && a < b);
+}
+
+void EngineEvent::siftUp(int pos) {
+    int i = heap_[pos];
+    while (pos > 0) {
+        int parent = (pos - 1) / 2;
+        if (!before(i, heap_[parent])) break;
+        heap_[pos] = heap_[parent];
+        heapPos_[heap_[pos]] = pos;
+        pos = parent;
+    }
+    heap_[pos] = i;
+    heapPos_[i] = pos;
+}
+
+void EngineEvent::siftDown(int pos) {
+    const int n = static_cast<int>(heap_.size());
+    int i = heap_[pos];
+    while (true) {
+        int child = 2 * pos + 1;
+        if (child >= n) break;
+        if (child + 1 < n && before(heap_[child + 1], heap_[child])) child++;
+        if (!before(heap_[child], i)) break;
+        heap_[pos] = heap_[child];
+        heapPos_[heap_[pos]] = pos;
+        pos = child;
+    }
+    heap_[pos] = i;
+    heapPos_[i] = pos;
+}
+
+void EngineEvent::update(int i) {
+    siftUp(heapPos_[i]);
+    siftDown(heapPos_[i]);
+}
+
+// Binary: time, body count, then the slots as they are in memory. The grid
+// and heap are rebuilt from them; both are determined by the slots alone.
+std::string EngineEvent::saveState() const {
+    uint64_t n = slots_.size();
+    std::string state(sizeof(time_) + sizeof(n) + n * sizeof(Slot), '\0');
+    char* out = &state[0];
+    std::memcpy(out, &time_, sizeof(time_));
+    std::memcpy(out + sizeof(time_), &n, sizeof(n));
+    if (n > 0) std::memcpy(out + sizeof(time_) + sizeof(n), slots_.data(), n * sizeof(Slot));
+    return state;
+}
+
+bool EngineEvent::loadState(const std::string& state) {
+    if (state.empty()) return true;   // Starts from the particles on the first step
+    uint64_t n = 0;
+    if (state.size() < sizeof(time_) + sizeof(n)) return false;
+    std::memcpy(&time_, state.data(), sizeof(time_));
+    std::memcpy(&n, state.data() + sizeof(time_), sizeof(n));
+    if (state.size() != sizeof(time_) + sizeof(n) + n * sizeof(Slot)) return false;
+    slots_.resize(n);
+    if (n > 0) std::memcpy(slots_.data(), state.data() + sizeof(time_) + sizeof(n), n * sizeof(Slot));
+
+    buildGrid();
+    heap_.resize(n);
+    heapPos_.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        heap_[i] = static_cast<int>(i);
+        heapPos_[i] = static_cast<int>(i);
+    }
+    for (int pos = static_cast<int>(n) / 2 - 1; pos >= 0; --pos) siftDown(pos);
+    collided_.assign(n, 0);
+    return true;
+}
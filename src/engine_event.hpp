@@ -0,0 +1,94 @@
+#pragma once
+
+#include "particle.hpp"
+#include "physics.hpp"
+#include "engine.hpp"
+#include <cstdint>
+#include <vector>
+
+// --method event: event-driven hard disks. Instead of moving everything by dt
+// and repairing overlaps, it predicts the exact time of every pair and wall
+// collision and jumps from one to the next, so disks never overlap and
+// collisions conserve energy up to rounding.
+//
+// State is kept in double precision between steps, each body with its own
+// time stamp (bodies only move when an event touches them). A grid with
+// cells of at least one diameter limits pair predictions to the 3x3
+// neighbourhood; leaving a cell is an event too. Every body has exactly one
+// entry in an indexed min-heap: its earliest predicted event. A pair event is
+// dropped when it reaches the top if the partner has collided since it was
+// predicted (its collision count moved on), and the body is re-predicted.
+//
+// step() processes the events up to t + dt and writes the positions at t + dt
+// into the particles. If the particles no longer match what the last step
+// wrote (first step, a swapped-in state), the engine starts over from them.
+class EngineEvent : public Engine {
+public:
+    EngineEvent(float box_w, float box_h, float r, const EngineParams& params = EngineParams());
+
+    void step(std::vector<Particle>& particles, float dt) override;
+    std::string describeParams() const override;
+    std::string saveState() const override;
+    bool loadState(const std::string& state) override;
+    size_t broadphaseBytes() const override;
+    size_t scratchBytes() const override;
+
+private:
+    enum class EventType : int32_t { None, Pair, WallX, WallY, CellX, CellY };
+
+    struct Body {
+        double x, y;       // Position at time t
+        double vx, vy;
+        double t;
+        float r;
+        int32_t id;
+    };
+
+    struct Event {
+        double time;
+        EventType type;
+        int32_t partner;        // Pair: index of the other body
+        uint32_t partnerCount;  // Pair: partner's collision count when predicted
+    };
+
+    // Everything per body that a checkpoint has to carry
+    struct Slot {
+        Body body;
+        Event event;
+        uint32_t count;      // Velocity changes so far
+        int32_t lastPartner; // Body of the last pair collision, -1 after a wall
+        int32_t cellX, cellY;
+    };
+
+    float box_w_, box_h_;
+    double time_ = 0.0;
+    std::vector<Slot> slots_;
+    std::vector<uint8_t> collided_;   // This step
+
+    // Grid: cell lists as intrusive doubly linked lists
+    int cellsX_ = 0, cellsY_ = 0;
+    double cellW_ = 0.0, cellH_ = 0.0;
+    std::vector<int> head_, next_, prev_;
+
+    // Indexed heap of body indices, ordered by (event time, index)
+    std::vector<int> heap_, heapPos_;
+
+    void rebuild(const std::vector<Particle>& particles);
+    void buildGrid();
+    bool matches(const std::vector<Particle>& particles) const;
+    void output(std::vector<Particle>& particles);
+    void captureContacts(const std::vector<Particle>& particles);
+
+    void advance(int i);
+    void predict(int i);
+    void collide(int i, int j);
+
+    int cellIndex(const Slot& s) const { return s.cellY * cellsX_ + s.cellX; }
+    void link(int i);
+    void unlink(int i);
+
+    bool before(int a, int b) const;
+    void siftUp(int pos);
+    void siftDown(int pos);
+    void update(int i);
+};
@@ -1,31 +1,73 @@
 #include "engine_hash.hpp"
 #include <algorithm>
+#include <cstdio>
 
-EngineHash::EngineHash(float box_w, float box_h, float r)
-    : spatialHash_(std::max(2.0f * r, 1.0f)),
-      box_w_(box_w), box_h_(box_h), r_(r), candidatePairsChecked_(0), collisionsThisStep_(0) {
+EngineHash::EngineHash(float box_w, float box_h, float r, const EngineParams& params)
+    : Engine(params),
+      spatialHash_(std::max(std::max(params.hashCellScale, 2.0f) * r, 1.0f),
+                   params.hashTableSize, params.hashMaxLoad),
+      box_w_(box_w), box_h_(box_h), r_(r) {
+}
+
+std::string EngineHash::describeParams() const {
+    char buf[96];
+    std::snprintf(buf, sizeof(buf), "cell=%gr table=%d max_load=%g%s",
+                  params_.hashCellScale, params_.hashTableSize, params_.hashMaxLoad, params_.ccd ? " ccd" : "");
+    return buf;
 }
 
 void EngineHash::step(std::vector<Particle>& particles, float dt) {
     candidatePairsChecked_ = 0;
     collisionsThisStep_ = 0;
-    
-    // Reset collision flags
-    for (auto& p : particles) {
-        p.collided = false;
+    phaseTimes_.clear();
+    energy_.reset();
+    if (params_.ccd) {
+        // Cells as wide as the longest swept diameter keep every path query
+        // to a few cells
+        stepSwept(particles, dt, box_w_, box_h_,
+                  [&] {
+                      float cell = std::max(std::max(params_.hashCellScale, 2.0f) * r_,
+                                            2.0f * ccd::maxSweptRadius(particles, dt));
+                      spatialHash_.clear(cell);
+                  },
+                  [this](const BodyRef& bounds) { spatialHash_.insert(bounds); },
+                  [this](float minX, float minY, float maxX, float maxY, std::vector<int>& out) {
+                      spatialHash_.queryAABB(minX, minY, maxX, maxY, out);
+                  });
+        return;
     }
     
-    // Integrate
-    physics::integrate(particles, dt);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Integrate);
+        
+        // Reset collision flags
+        for (auto& p : particles) {
+            p.collided = false;
+        }
+        
+        // Integrate
+        physics::integrate(particles, dt);
+    }
     
     // Handle walls
-    physics::handle_walls(particles, box_w_, box_h_, r_);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Walls);
+        physics::handle_walls(particles, box_w_, box_h_, r_, energyOut());
+    }
     
     // Build broad-phase
-    buildBroadPhase(particles);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Build);
+        buildBroadPhase(particles);
+    }
+    
+    captureBuild(particles);
     
     // Narrow-phase collision detection and resolution
-    narrowPhase(particles);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Narrow);
+        narrowPhase(particles);
+    }
 }
 
 void EngineHash::buildBroadPhase(const std::vector<Particle>& particles) {
@@ -38,52 +80,56 @@ void EngineHash::buildBroadPhase(const std::vector<Particle>& particles) {
 
 void EngineHash::narrowPhase(std::vector<Particle>& particles) {
     // Track pairs we've already processed this step
-    std::vector<std::pair<int, int>> processedPairs;
+    processedPairs_.clear();
     
     // Create ID to index map
-    std::vector<int> idToIndex(particles.size());
+    idToIndex_.resize(particles.size());
     for (size_t i = 0; i < particles.size(); ++i) {
-        idToIndex[particles[i].id] = i;
+        idToIndex_[particles[i].id] = i;
     }
     
     for (size_t i = 0; i < particles.size(); ++i) {
         auto& p = particles[i];
         
         // Query neighbors within 2*r radius
-        std::vector<int> candidates;
-        spatialHash_.query(p.x, p.y, 2.0f * r_, candidates);
+        spatialHash_.query(p.x, p.y, 2.0f * r_, candidates_);
         
-        candidatePairsChecked_ += candidates.size();
+        candidatePairsChecked_ += candidates_.size();
         
-        for (int j_id : candidates) {
-            if (j_id <= static_cast<int>(p.id)) continue; // Avoid duplicate pairs
+        for (int j_id : candidates_) {
+            captureCandidate(p.id, j_id);
+            if (j_id <= static_cast<int>(p.id)) { // Avoid duplicate pairs
+                if (pairLog_ && j_id != p.id) pairLog_->record(p.id, j_id, false, false);
+                continue;
+            }
             
             // Check if already processed
             bool alreadyProcessed = false;
-            for (const auto& pair : processedPairs) {
+            for (const auto& pair : processedPairs_) {
                 if ((pair.first == p.id && pair.second == j_id) ||
                     (pair.first == j_id && pair.second == p.id)) {
                     alreadyProcessed = true;
                     break;
                 }
             }
-            if (alreadyProcessed) continue;
+            if (alreadyProcessed) {
+                if (pairLog_) pairLog_->record(p.id, j_id, false, false);
+                continue;
+            }
             
             if (j_id < 0 || j_id >= static_cast<int>(particles.size())) continue;
-            int j_idx = idToIndex[j_id];
+            int j_idx = idToIndex_[j_id];
             auto& other = particles[j_idx];
             
             // Narrow-phase test
-            if (physics::circle_overlap(p, other)) {
-                physics::resolve_collision(p, other);
+            bool overlap = physics::circle_overlap(p, other);
+            if (pairLog_) pairLog_->record(p.id, j_id, true, overlap);
+            if (overlap) {
+                physics::resolve_collision(p, other, energyOut());
                 physics::positional_correction(p, other);
-                processedPairs.push_back({p.id, other.id});
+                processedPairs_.push_back({p.id, other.id});
                 collisionsThisStep_++;
             }
         }
     }
-<<<<<<< HEAD
-}
-=======
 }
->>>>>>> sian
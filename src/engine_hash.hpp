@@ -3,29 +3,22 @@
 #include "particle.hpp"
 #include "spatial_hash.hpp"
 #include "physics.hpp"
+#include "engine.hpp"
 #include <vector>
 
-class EngineHash {
+class EngineHash : public Engine {
 public:
-    EngineHash(float box_w, float box_h, float r);
+    EngineHash(float box_w, float box_h, float r, const EngineParams& params = EngineParams());
     
-    void step(std::vector<Particle>& particles, float dt);
-    
-    // Metrics
-    int getCandidatePairsChecked() const { return candidatePairsChecked_; }
-    int getCollisionsThisStep() const { return collisionsThisStep_; }
-    void resetMetrics() { candidatePairsChecked_ = 0; collisionsThisStep_ = 0; }
+    void step(std::vector<Particle>& particles, float dt) override;
+    std::string describeParams() const override;
+    size_t broadphaseBytes() const override { return spatialHash_.memoryBytes(); }
+    void collectBroadphaseStats(BroadphaseStats& out) const override { spatialHash_.collectStats(out); }
     
 private:
     SpatialHash spatialHash_;
     float box_w_, box_h_, r_;
-    int candidatePairsChecked_;
-    int collisionsThisStep_;
     
     void buildBroadPhase(const std::vector<Particle>& particles);
     void narrowPhase(std::vector<Particle>& particles);
-<<<<<<< HEAD
-};
-=======
 };
->>>>>>> sian
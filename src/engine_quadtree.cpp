@@ -1,31 +1,80 @@
 #include "engine_quadtree.hpp"
 #include <algorithm>
 
-EngineQuadtree::EngineQuadtree(float box_w, float box_h, float r)
-    : quadtree_(0.0f, 0.0f, box_w, box_h, 8, 12),
-      box_w_(box_w), box_h_(box_h), r_(r), candidatePairsChecked_(0), collisionsThisStep_(0) {
+EngineQuadtree::EngineQuadtree(float box_w, float box_h, float r, const EngineParams& params)
+    : Engine(params),
+      quadtree_(0.0f, 0.0f, box_w, box_h, params.quadtreeCap, params.quadtreeMaxDepth),
+      box_w_(box_w), box_h_(box_h), r_(r) {
+}
+
+std::string EngineQuadtree::describeParams() const {
+    return "cap=" + std::to_string(params_.quadtreeCap) +
+           " max_depth=" + std::to_string(params_.quadtreeMaxDepth) + (params_.ccd ? " ccd" : "");
 }
 
 void EngineQuadtree::step(std::vector<Particle>& particles, float dt) {
     candidatePairsChecked_ = 0;
     collisionsThisStep_ = 0;
-    
-    // this resets collision flags
-    for (auto& p : particles) {
-        p.collided = false;
+    phaseTimes_.clear();
+    energy_.reset();
+    if (params_.ccd) {
+        // The root reaches past the walls by the longest swept radius, so every
+        // path fits the tree; bounds of paths sped up by a bounce may still
+        // not, and are kept in outside_ and tested against every query
+        stepSwept(particles, dt, box_w_, box_h_,
+                  [&] {
+                      float reach = ccd::maxSweptRadius(particles, dt);
+                      quadtree_.clear(-reach, -reach, box_w_ + 2.0f * reach, box_h_ + 2.0f * reach);
+                      outside_.clear();
+                  },
+                  [this](const BodyRef& bounds) {
+                      if (!quadtree_.insert(bounds)) {
+                          outside_.push_back(bounds);
+                      }
+                  },
+                  [this](float minX, float minY, float maxX, float maxY, std::vector<int>& out) {
+                      quadtree_.queryAABB(minX, minY, maxX, maxY, out);
+                      for (const auto& body : outside_) {
+                          if (body.x - body.r < maxX && body.x + body.r > minX &&
+                              body.y - body.r < maxY && body.y + body.r > minY) {
+                              out.push_back(body.id);
+                          }
+                      }
+                  });
+        return;
     }
     
-    //  integrates positions
-    physics::integrate(particles, dt);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Integrate);
+        
+        // this resets collision flags
+        for (auto& p : particles) {
+            p.collided = false;
+        }
+        
+        //  integrates positions
+        physics::integrate(particles, dt);
+    }
     
     // handle wall collisions
-    physics::handle_walls(particles, box_w_, box_h_, r_);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Walls);
+        physics::handle_walls(particles, box_w_, box_h_, r_, energyOut());
+    }
     
     // Build broad-phase quadtree
-    buildBroadPhase(particles);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Build);
+        buildBroadPhase(particles);
+    }
+    
+    captureBuild(particles);
     
     // Narrow-phase collision detection and resolution
-    narrowPhase(particles);
+    {
+        ScopedPhase phase(phaseTimes_, Phase::Narrow);
+        narrowPhase(particles);
+    }
 }
 
 void EngineQuadtree::buildBroadPhase(const std::vector<Particle>& particles) {
@@ -38,46 +87,54 @@ void EngineQuadtree::buildBroadPhase(const std::vector<Particle>& particles) {
 
 void EngineQuadtree::narrowPhase(std::vector<Particle>& particles) {
     // container for pairs we've already processed in current step
-    std::vector<std::pair<int, int>> processedPairs;
+    processedPairs_.clear();
     
     // Create ID to index map
-    std::vector<int> idToIndex(particles.size());
+    idToIndex_.resize(particles.size());
     for (size_t i = 0; i < particles.size(); ++i) {
-        idToIndex[particles[i].id] = i;
+        idToIndex_[particles[i].id] = i;
     }
     
     for (size_t i = 0; i < particles.size(); ++i) {
         auto& p = particles[i];
         
         // Query neighbors within 2*r radius
-        std::vector<int> candidates;
-        quadtree_.query(p.x, p.y, 2.0f * r_, candidates);
+        quadtree_.query(p.x, p.y, 2.0f * r_, candidates_);
         
-        candidatePairsChecked_ += candidates.size();
+        candidatePairsChecked_ += candidates_.size();
         
-        for (int j_id : candidates) {
-            if (j_id <= static_cast<int>(p.id)) continue; // Avoid duplicate pairs
+        for (int j_id : candidates_) {
+            captureCandidate(p.id, j_id);
+            if (j_id <= static_cast<int>(p.id)) { // Avoid duplicate pairs
+                if (pairLog_ && j_id != p.id) pairLog_->record(p.id, j_id, false, false);
+                continue;
+            }
             
             // Check if already processed
             bool alreadyProcessed = false;
-            for (const auto& pair : processedPairs) {
+            for (const auto& pair : processedPairs_) {
                 if ((pair.first == p.id && pair.second == j_id) ||
                     (pair.first == j_id && pair.second == p.id)) {
                     alreadyProcessed = true;
                     break;
                 }
             }
-            if (alreadyProcessed) continue;
+            if (alreadyProcessed) {
+                if (pairLog_) pairLog_->record(p.id, j_id, false, false);
+                continue;
+            }
             
             if (j_id < 0 || j_id >= static_cast<int>(particles.size())) continue;
-            int j_idx = idToIndex[j_id];
+            int j_idx = idToIndex_[j_id];
             auto& other = particles[j_idx];
             
             // Narrow-phase test
-            if (physics::circle_overlap(p, other)) {
-                physics::resolve_collision(p, other);
+            bool overlap = physics::circle_overlap(p, other);
+            if (pairLog_) pairLog_->record(p.id, j_id, true, overlap);
+            if (overlap) {
+                physics::resolve_collision(p, other, energyOut());
                 physics::positional_correction(p, other);
-                processedPairs.push_back({p.id, other.id});
+                processedPairs_.push_back({p.id, other.id});
                 collisionsThisStep_++;
             }
         }
@@ -3,24 +3,25 @@
 #include "particle.hpp"
 #include "quadtree.hpp"
 #include "physics.hpp"
+#include "engine.hpp"
 #include <vector>
 
-class EngineQuadtree {
+class EngineQuadtree : public Engine {
 public:
-    EngineQuadtree(float box_w, float box_h, float r);
+    EngineQuadtree(float box_w, float box_h, float r, const EngineParams& params = EngineParams());
     
-    void step(std::vector<Particle>& particles, float dt);
-    
-    // metricss
-    int getCandidatePairsChecked() const { return candidatePairsChecked_; }
-    int getCollisionsThisStep() const { return collisionsThisStep_; }
-    void resetMetrics() { candidatePairsChecked_ = 0; collisionsThisStep_ = 0; }
+    void step(std::vector<Particle>& particles, float dt) override;
+    std::string describeParams() const override;
+    size_t broadphaseBytes() const override { return quadtree_.memoryBytes(); }
+    void collectBroadphaseStats(BroadphaseStats& out) const override { quadtree_.collectStats(out); }
+    size_t scratchBytes() const override {
+        return Engine::scratchBytes() + outside_.capacity() * sizeof(BodyRef);
+    }
     
 private:
     Quadtree quadtree_;
     float box_w_, box_h_, r_;
-    int candidatePairsChecked_;
-    int collisionsThisStep_;
+    std::vector<BodyRef> outside_;   // --ccd: swept bounds reaching past the walls, not in the tree
     
     void buildBroadPhase(const std::vector<Particle>& particles);
     void narrowPhase(std::vector<Particle>& particles);
@@ -0,0 +1,140 @@
+#include "histogram.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+int highestBit(uint64_t v) {
+    return 63 - __builtin_clzll(v);
+}
+
+template <typename T>
+void put(std::string& out, const T& v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+template <typename T>
+bool get(const std::string& in, size_t& pos, T& v) {
+    if (pos + sizeof(T) > in.size()) return false;
+    std::memcpy(&v, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+}
+
+LatencyHistogram::LatencyHistogram(int significantDigits, uint64_t highestValue)
+    : digits_(std::clamp(significantDigits, 1, 5)),
+      highestValue_(std::max<uint64_t>(highestValue, 2)),
+      totalCount_(0), min_(UINT64_MAX), max_(0), sum_(0) {
+    uint64_t largestSingleUnit = 2 * static_cast<uint64_t>(std::pow(10.0, digits_));
+    int subBucketCountMagnitude = highestBit(largestSingleUnit - 1) + 1;
+    subBucketHalfCountMagnitude_ = subBucketCountMagnitude - 1;
+    subBucketHalfCount_ = uint64_t(1) << subBucketHalfCountMagnitude_;
+    subBucketMask_ = (uint64_t(1) << subBucketCountMagnitude) - 1;
+    counts_.assign(indexOf(highestValue_) + 1, 0);
+}
+
+size_t LatencyHistogram::indexOf(uint64_t value) const {
+    int bucket = highestBit(value | subBucketMask_) - subBucketHalfCountMagnitude_;
+    uint64_t subBucket = value >> bucket;
+    return (static_cast<size_t>(bucket) << subBucketHalfCountMagnitude_) + subBucket;
+}
+
+uint64_t LatencyHistogram::highestEquivalentValue(size_t index) const {
+    int bucket = 0;
+    uint64_t subBucket = index;
+    if (index >= 2 * subBucketHalfCount_) {
+        bucket = static_cast<int>(index >> subBucketHalfCountMagnitude_) - 1;
+        subBucket = index - (static_cast<uint64_t>(bucket) << subBucketHalfCountMagnitude_);
+    }
+    return (subBucket << bucket) + ((uint64_t(1) << bucket) - 1);
+}
+
+void LatencyHistogram::record(uint64_t value, uint64_t count) {
+    if (count == 0) return;
+    value = std::min(value, highestValue_);
+    counts_[indexOf(value)] += count;
+    totalCount_ += count;
+    sum_ += value * count;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::clear() {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    totalCount_ = 0;
+    min_ = UINT64_MAX;
+    max_ = 0;
+    sum_ = 0;
+}
+
+bool LatencyHistogram::merge(const LatencyHistogram& other) {
+    if (other.digits_ != digits_ || other.highestValue_ != highestValue_) return false;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        counts_[i] += other.counts_[i];
+    }
+    totalCount_ += other.totalCount_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+    return true;
+}
+
+uint64_t LatencyHistogram::valueAtPercentile(double p) const {
+    if (totalCount_ == 0) return 0;
+    p = std::clamp(p, 0.0, 1.0);
+    uint64_t rank = static_cast<uint64_t>(std::floor(p * (totalCount_ - 1))) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        seen += counts_[i];
+        if (seen >= rank) {
+            return std::min(highestEquivalentValue(i), max_);
+        }
+    }
+    return max_;
+}
+
+std::string LatencyHistogram::save() const {
+    std::string out;
+    put(out, static_cast<int32_t>(digits_));
+    put(out, highestValue_);
+    put(out, totalCount_);
+    put(out, min_);
+    put(out, max_);
+    put(out, sum_);
+    uint64_t nonZero = static_cast<uint64_t>(
+        std::count_if(counts_.begin(), counts_.end(), [](uint64_t c) { return c != 0; }));
+    put(out, nonZero);
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        if (counts_[i] != 0) {
+            put(out, static_cast<uint32_t>(i));
+            put(out, counts_[i]);
+        }
+    }
+    return out;
+}
+
+bool LatencyHistogram::load(const std::string& state) {
+    size_t pos = 0;
+    int32_t digits;
+    uint64_t highestValue, nonZero;
+    if (!get(state, pos, digits) || !get(state, pos, highestValue)) return false;
+    if (digits != digits_ || highestValue != highestValue_) return false;
+
+    clear();
+    if (!get(state, pos, totalCount_) || !get(state, pos, min_) || !get(state, pos, max_) ||
+        !get(state, pos, sum_) || !get(state, pos, nonZero)) {
+        return false;
+    }
+    for (uint64_t k = 0; k < nonZero; ++k) {
+        uint32_t index;
+        uint64_t count;
+        if (!get(state, pos, index) || !get(state, pos, count) || index >= counts_.size()) {
+            return false;
+        }
+        counts_[index] = count;
+    }
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Log-bucketed value histogram in the style of HdrHistogram
+//
+// Values are non-negative integers (step latencies are recorded in
+// nanoseconds). Each power-of-two range is split into 2^k linear sub-buckets,
+// where 2^k is the smallest power of two >= 2 * 10^digits, so every recorded
+// value is kept to `digits` significant decimal digits. Values below the
+// sub-bucket count are exact. Memory is fixed when the histogram is created
+// and record() is O(1); values above highestValue are clamped to it.
+
+class LatencyHistogram {
+public:
+    explicit LatencyHistogram(int significantDigits = 3, uint64_t highestValue = uint64_t(1) << 42);
+
+    void record(uint64_t value, uint64_t count = 1);
+    void clear();
+
+    // Adds another histogram's counts; false if the two were built with
+    // different precision or range.
+    bool merge(const LatencyHistogram& other);
+
+    // Value at percentile p in [0, 1], matching the sorted[floor(p * (n - 1))]
+    // rank used for the exact percentiles: the highest value equivalent to the
+    // bucket holding that rank, capped at the recorded maximum.
+    uint64_t valueAtPercentile(double p) const;
+
+    uint64_t count() const { return totalCount_; }
+    uint64_t min() const { return totalCount_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return totalCount_ ? static_cast<double>(sum_) / totalCount_ : 0.0; }
+    int significantDigits() const { return digits_; }
+    size_t memoryBytes() const { return counts_.size() * sizeof(uint64_t); }
+
+    // Compact binary form (non-zero buckets only), for checkpoints and for
+    // merging histograms written by separate runs
+    std::string save() const;
+    bool load(const std::string& state);
+
+private:
+    int digits_;
+    uint64_t highestValue_;
+    int subBucketHalfCountMagnitude_;
+    uint64_t subBucketHalfCount_;
+    uint64_t subBucketMask_;
+    std::vector<uint64_t> counts_;
+
+    uint64_t totalCount_;
+    uint64_t min_;
+    uint64_t max_;
+    uint64_t sum_;
+
+    size_t indexOf(uint64_t value) const;
+    uint64_t highestEquivalentValue(size_t index) const;
+};
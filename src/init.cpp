@@ -0,0 +1,277 @@
+#include "init.hpp"
+#include "parallel.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+constexpr int kMaxAttempts = 1000;
+constexpr int kParticlesPerTile = 256;    // Target for --init_mode tiled
+constexpr int kMinTileCells = 4;          // Same-colour tiles stay >= 2 grid cells apart
+constexpr int kLatticeChunk = 4096;       // Particles per parallel work item
+
+// CounterRNG streams of a particle: where it goes and how fast it moves, kept
+// apart so the velocity does not depend on how many placements were tried
+constexpr uint32_t kStreamPlacement = 0;
+constexpr uint32_t kStreamVelocity = 1;
+
+// Random velocity in bounded range (increased for more collisions)
+template <typename Rng>
+void randomVelocity(Rng& rng, float& vx, float& vy) {
+    float speed = rng.uniform(400.0f, 600.0f);
+    float angle = rng.uniform(0.0f, 2.0f * 3.14159265359f);
+    vx = speed * std::cos(angle);
+    vy = speed * std::sin(angle);
+}
+
+// Uniform grid over the box for the non-overlap test. Cells are at least 2r
+// wide, so every particle closer than 2r sits in the 3x3 block around the
+// query; each cell is a linked list through next_ (indices into the particle
+// vector). Inserts into different cells may run concurrently.
+class PlacementGrid {
+public:
+    PlacementGrid(int N, float box_w, float box_h, float r) : r_(r) {
+        float area = box_w * box_h;
+        cell_ = std::max(2.0f * r, std::sqrt(area / std::max(N, 1)));
+        cols_ = std::max(1, static_cast<int>(std::ceil(box_w / cell_)));
+        rows_ = std::max(1, static_cast<int>(std::ceil(box_h / cell_)));
+        head_.assign(static_cast<size_t>(cols_) * rows_, -1);
+        next_.assign(N, -1);
+    }
+
+    float cellSize() const { return cell_; }
+    int cols() const { return cols_; }
+    int rows() const { return rows_; }
+
+    bool isFree(const std::vector<Particle>& particles, float x, float y) const {
+        int cx = cellX(x), cy = cellY(y);
+        float rSum = 2.0f * r_;
+        for (int gy = std::max(cy - 1, 0); gy <= std::min(cy + 1, rows_ - 1); ++gy) {
+            for (int gx = std::max(cx - 1, 0); gx <= std::min(cx + 1, cols_ - 1); ++gx) {
+                for (int i = head_[static_cast<size_t>(gy) * cols_ + gx]; i >= 0; i = next_[i]) {
+                    float dx = x - particles[i].x;
+                    float dy = y - particles[i].y;
+                    if (dx * dx + dy * dy < rSum * rSum) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void insert(const std::vector<Particle>& particles, int index) {
+        size_t cell = static_cast<size_t>(cellY(particles[index].y)) * cols_ + cellX(particles[index].x);
+        next_[index] = head_[cell];
+        head_[cell] = index;
+    }
+
+private:
+    float r_;
+    float cell_;
+    int cols_, rows_;
+    std::vector<int> head_;
+    std::vector<int> next_;
+
+    int cellX(float x) const { return std::clamp(static_cast<int>(x / cell_), 0, cols_ - 1); }
+    int cellY(float y) const { return std::clamp(static_cast<int>(y / cell_), 0, rows_ - 1); }
+};
+
+// Original sequential rejection sampling; the grid only replaces the scan
+// over every placed particle, so positions and RNG use are unchanged
+std::vector<Particle> randomParticles(const SimConfig& config, RNG& rng) {
+    std::vector<Particle> particles;
+    particles.reserve(config.N);
+    PlacementGrid grid(config.N, config.box_w, config.box_h, config.radius);
+
+    for (int i = 0; i < config.N; ++i) {
+        float x, y;
+        bool valid = false;
+        int attempts = 0;
+        while (!valid && attempts < kMaxAttempts) {
+            x = rng.uniform(config.radius, config.box_w - config.radius);
+            y = rng.uniform(config.radius, config.box_h - config.radius);
+            valid = grid.isFree(particles, x, y);
+            attempts++;
+        }
+
+        if (!valid) {
+            std::cerr << "Warning: Could not place particle " << i << " after " << kMaxAttempts << " attempts" << std::endl;
+        }
+
+        float vx, vy;
+        randomVelocity(rng, vx, vy);
+        particles.emplace_back(x, y, vx, vy, config.radius, i);
+        grid.insert(particles, i);
+    }
+
+    return particles;
+}
+
+// Tiles are squares of whole grid cells. Each gets a share of N proportional
+// to its usable area (at least r from the walls) as a contiguous id range, and
+// places them in id order with each particle's own CounterRNG streams, so the
+// result is fixed by the seed alone.
+std::vector<Particle> tiledParticles(const SimConfig& config) {
+    const int N = config.N;
+    const float r = config.radius;
+    PlacementGrid grid(N, config.box_w, config.box_h, r);
+    float cell = grid.cellSize();
+    float particlesPerCell = static_cast<float>(N) / (static_cast<float>(grid.cols()) * grid.rows());
+    int tileCells = std::max(kMinTileCells,
+                             static_cast<int>(std::ceil(std::sqrt(kParticlesPerTile / std::max(particlesPerCell, 1e-6f)))));
+    tileCells = std::min(tileCells, std::max(grid.cols(), grid.rows()));
+    float tileSize = tileCells * cell;
+    int tilesX = (grid.cols() + tileCells - 1) / tileCells;
+    int tilesY = (grid.rows() + tileCells - 1) / tileCells;
+    int tiles = tilesX * tilesY;
+
+    struct Tile {
+        float x0, y0, x1, y1;   // Where centres may go
+        int begin, end;         // Id range
+        int failed = 0;
+    };
+    std::vector<Tile> tileList(tiles);
+    std::vector<double> usable(tiles);
+    double usableTotal = 0.0;
+    for (int t = 0; t < tiles; ++t) {
+        Tile& tile = tileList[t];
+        tile.x0 = std::max(r, (t % tilesX) * tileSize);
+        tile.y0 = std::max(r, (t / tilesX) * tileSize);
+        tile.x1 = std::min(config.box_w - r, (t % tilesX + 1) * tileSize);
+        tile.y1 = std::min(config.box_h - r, (t / tilesX + 1) * tileSize);
+        usable[t] = std::max(0.0f, tile.x1 - tile.x0) * static_cast<double>(std::max(0.0f, tile.y1 - tile.y0));
+        usableTotal += usable[t];
+    }
+    double cumulative = 0.0;
+    int assigned = 0;
+    for (int t = 0; t < tiles; ++t) {
+        cumulative += usable[t];
+        int end = t + 1 == tiles ? N : static_cast<int>(N * (cumulative / std::max(usableTotal, 1e-30)));
+        tileList[t].begin = assigned;
+        tileList[t].end = std::max(assigned, std::min(end, N));
+        assigned = tileList[t].end;
+    }
+
+    std::vector<Particle> particles(N);
+    auto fillTile = [&](int t) {
+        Tile& tile = tileList[t];
+        for (int i = tile.begin; i < tile.end; ++i) {
+            CounterRNG rng(config.seed, static_cast<uint32_t>(i), kStreamPlacement);
+            float x, y;
+            bool valid = false;
+            int attempts = 0;
+            while (!valid && attempts < kMaxAttempts) {
+                x = rng.uniform(tile.x0, tile.x1);
+                y = rng.uniform(tile.y0, tile.y1);
+                valid = grid.isFree(particles, x, y);
+                attempts++;
+            }
+            if (!valid) tile.failed++;
+            CounterRNG velocityRng(config.seed, static_cast<uint32_t>(i), kStreamVelocity);
+            float vx, vy;
+            randomVelocity(velocityRng, vx, vy);
+            particles[i] = Particle(x, y, vx, vy, r, i);
+            grid.insert(particles, i);
+        }
+    };
+
+    // Four passes over a 2x2 colouring: tiles of one colour are a whole tile
+    // apart, so they never read or write the same grid cells
+    std::vector<int> colour;
+    for (int pass = 0; pass < 4; ++pass) {
+        colour.clear();
+        for (int t = 0; t < tiles; ++t) {
+            if ((t % tilesX) % 2 == pass % 2 && (t / tilesX) % 2 == pass / 2) colour.push_back(t);
+        }
+        parallelFor(static_cast<int>(colour.size()), config.threads, [&](int k) { fillTile(colour[k]); });
+    }
+
+    int failed = 0;
+    for (const auto& tile : tileList) failed += tile.failed;
+    if (failed > 0) {
+        std::cerr << "Warning: " << failed << " particles placed with overlaps after " << kMaxAttempts
+                  << " attempts each; try --init_mode lattice" << std::endl;
+    }
+    return particles;
+}
+
+// Sites span [r, box - r] in both directions, so the outer rows and columns
+// touch the walls and the spacing is as large as the box allows
+struct LatticeShape {
+    int cols, rows;
+    float x0, y0;       // First site
+    float dx, dy;       // Site spacing; odd rows are shifted by dx / 2
+    float minDist;      // Between neighbouring sites
+};
+
+LatticeShape latticeShape(int N, float box_w, float box_h, float r) {
+    LatticeShape s;
+    float innerW = std::max(box_w - 2.0f * r, 0.0f);
+    float innerH = std::max(box_h - 2.0f * r, 0.0f);
+    s.cols = std::max(1, static_cast<int>(std::ceil(std::sqrt(N * std::sqrt(3.0) * innerW / (2.0 * std::max(innerH, 1e-6f))))));
+    s.rows = std::max(1, (N + s.cols - 1) / s.cols);
+    float spans = s.cols - 1 + (s.rows > 1 ? 0.5f : 0.0f);
+    s.dx = spans > 0.0f ? innerW / spans : innerW;
+    s.dy = s.rows > 1 ? innerH / (s.rows - 1) : innerH;
+    s.x0 = spans > 0.0f ? r : 0.5f * box_w;
+    s.y0 = s.rows > 1 ? r : 0.5f * box_h;
+    s.minDist = s.cols > 1 ? s.dx : std::numeric_limits<float>::max();
+    if (s.rows > 1) s.minDist = std::min({s.minDist, std::hypot(0.5f * s.dx, s.dy), 2.0f * s.dy});
+    return s;
+}
+
+}
+
+std::vector<Particle> latticeParticles(int N, float box_w, float box_h, float r, uint64_t seed, int threads) {
+    LatticeShape s = latticeShape(N, box_w, box_h, r);
+    // Per-axis jitter that keeps every pair 2r apart; clamping to the walls
+    // only shortens a displacement
+    float jitter = std::max(0.0f, (std::min(s.minDist, 1e30f) - 2.0f * r) / (2.0f * std::sqrt(2.0f)));
+    jitter = std::min(jitter, 0.5f * std::max(box_w, box_h));
+
+    std::vector<Particle> particles(N);
+    int chunks = (N + kLatticeChunk - 1) / kLatticeChunk;
+    parallelFor(chunks, threads, [&](int c) {
+        int end = std::min(N, (c + 1) * kLatticeChunk);
+        for (int i = c * kLatticeChunk; i < end; ++i) {
+            CounterRNG rng(seed, static_cast<uint32_t>(i), kStreamPlacement);
+            int row = i / s.cols;
+            float shift = row % 2 ? 0.5f * s.dx : 0.0f;
+            float x = s.x0 + (i % s.cols) * s.dx + shift + rng.uniform(-jitter, jitter);
+            float y = s.y0 + row * s.dy + rng.uniform(-jitter, jitter);
+            x = std::clamp(x, r, std::max(r, box_w - r));
+            y = std::clamp(y, r, std::max(r, box_h - r));
+            CounterRNG velocityRng(seed, static_cast<uint32_t>(i), kStreamVelocity);
+            float vx, vy;
+            randomVelocity(velocityRng, vx, vy);
+            particles[i] = Particle(x, y, vx, vy, r, i);
+        }
+    });
+    return particles;
+}
+
+bool latticeFits(int N, float box_w, float box_h, float r) {
+    return latticeShape(N, box_w, box_h, r).minDist >= 2.0f * r;
+}
+
+bool isInitMode(const std::string& mode) {
+    return mode == "random" || mode == "tiled" || mode == "lattice";
+}
+
+std::vector<Particle> initializeParticles(const SimConfig& config, RNG& rng) {
+    if (config.init_mode == "random") {
+        return randomParticles(config, rng);
+    }
+    if (config.init_mode == "tiled") {
+        return tiledParticles(config);
+    }
+    if (config.init_mode == "lattice") {
+        if (!latticeFits(config.N, config.box_w, config.box_h, config.radius)) {
+            std::cerr << "Warning: " << config.N << " particles of radius " << config.radius
+                      << " do not fit the lattice without overlaps" << std::endl;
+        }
+        return latticeParticles(config.N, config.box_w, config.box_h, config.radius, config.seed, config.threads);
+    }
+    return {};
+}
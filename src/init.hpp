@@ -0,0 +1,29 @@
+#pragma once
+
+#include "particle.hpp"
+#include "sim_config.hpp"
+#include "rng.hpp"
+#include <cstdint>
+#include <vector>
+
+// Initial particles for --init_mode (deterministic for a given --seed):
+//   random   Rejection sampling in id order from `rng`, tested against a
+//            background grid; same positions as the original all-pairs test.
+//   tiled    Rejection sampling per tile, tiles filled in parallel in four
+//            checkerboard passes so neighbours never run at the same time.
+//   lattice  latticeParticles(); reaches near-packing densities.
+// tiled and lattice draw each particle's numbers from its own CounterRNG
+// instead of `rng`, so their result does not depend on --threads. Returns an
+// empty vector for an unknown mode.
+std::vector<Particle> initializeParticles(const SimConfig& config, RNG& rng);
+
+// Hexagonal lattice with one particle per site, jittered around the site as
+// far as the spacing allows without overlaps
+std::vector<Particle> latticeParticles(int N, float box_w, float box_h, float r, uint64_t seed,
+                                       int threads = 1);
+
+// Whether latticeParticles() can place N particles without overlaps
+bool latticeFits(int N, float box_w, float box_h, float r);
+
+// Names accepted by --init_mode
+bool isInitMode(const std::string& mode);
@@ -0,0 +1,273 @@
+#include "init_file.hpp"
+#include "checkpoint.hpp"
+#include "delta_trajectory.hpp"
+#include "parallel.hpp"
+#include "trajectory.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kParticlesPerTask = 1 << 16;
+constexpr size_t kMinChunkBytes = 1 << 20;   // Smaller CSV chunks are not worth a thread
+constexpr size_t kLinearScanBytes = 4096;    // Where the search for the last step goes linear
+
+// Whole file mapped read-only
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped != MAP_FAILED) {
+                data_ = static_cast<const char*>(mapped);
+                size_ = static_cast<size_t>(st.st_size);
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile() {
+        if (data_) munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+bool checkGeometry(const std::string& path, const SimConfig& config, uint64_t N, float radius,
+                   float box_w, float box_h) {
+    if (N != static_cast<uint64_t>(config.N) || radius != config.radius ||
+        box_w != config.box_w || box_h != config.box_h) {
+        std::cerr << "Error: " << path << " holds N=" << N << " radius=" << radius << " box=" << box_w
+                  << "x" << box_h << ", run has N=" << config.N << " radius=" << config.radius
+                  << " box=" << config.box_w << "x" << config.box_h << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Particles i = 0..N-1 from column arrays, in parallel blocks
+void fromColumns(const float* x, const float* y, const float* vx, const float* vy, const SimConfig& config,
+                 std::vector<Particle>& particles) {
+    const int N = config.N;
+    particles.resize(N);
+    parallelFor((N + kParticlesPerTask - 1) / kParticlesPerTask, config.threads, [&](int task) {
+        int end = std::min(N, (task + 1) * kParticlesPerTask);
+        for (int i = task * kParticlesPerTask; i < end; ++i) {
+            particles[i] = Particle(x[i], y[i], vx[i], vy[i], config.radius, i);
+        }
+    });
+}
+
+bool loadTrajectory(const std::string& path, const SimConfig& config, std::vector<Particle>& particles) {
+    TrajectoryReader reader(path);
+    if (!reader.isOpen()) return false;
+    const TrajectoryHeader& h = reader.header();
+    if (!checkGeometry(path, config, h.N, h.radius, h.box_w, h.box_h)) return false;
+    if (reader.frameCount() == 0) {
+        std::cerr << "Error: No frames in " << path << std::endl;
+        return false;
+    }
+    TrajectoryFrame frame = reader.frame(reader.frameCount() - 1);
+    fromColumns(frame.x, frame.y, frame.vx, frame.vy, config, particles);
+    return true;
+}
+
+bool loadDeltaTrajectory(const std::string& path, const SimConfig& config, std::vector<Particle>& particles) {
+    DeltaTrajectoryReader reader(path);
+    if (!reader.isOpen()) return false;
+    const DeltaTrajectoryHeader& h = reader.header();
+    if (!checkGeometry(path, config, h.N, h.radius, h.box_w, h.box_h)) return false;
+    if (!reader.keyframes().empty() && !reader.seekKeyframe(reader.keyframes().size() - 1)) return false;
+
+    DeltaFrame frame, next;
+    bool any = false;
+    while (reader.readFrame(next)) {
+        std::swap(frame, next);
+        any = true;
+    }
+    if (!any) {
+        std::cerr << "Error: No frames in " << path << std::endl;
+        return false;
+    }
+    fromColumns(frame.x.data(), frame.y.data(), frame.vx.data(), frame.vy.data(), config, particles);
+    return true;
+}
+
+// Start of the line after the one containing p (or end)
+const char* nextLine(const char* p, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+    return nl ? nl + 1 : end;
+}
+
+// Leading step field of the line at p; -1 if there is none
+long stepAt(const char* p, const char* end) {
+    long step = -1;
+    std::from_chars(p, end, step);
+    return step;
+}
+
+struct CsvError {
+    const char* at = nullptr;
+    const char* what = nullptr;
+};
+
+// Rows of [begin, end), all of which must belong to `step`
+CsvError parseRows(const char* begin, const char* end, long step, const SimConfig& config,
+                   std::atomic<uint8_t>* seen, std::vector<Particle>& particles, int& count) {
+    for (const char* line = begin; line < end; line = nextLine(line, end)) {
+        if (*line == '\n' || *line == '\r') continue;
+
+        long rowStep = 0;
+        int id = 0;
+        float v[4];
+        const char* p = line;
+        auto r = std::from_chars(p, end, rowStep);
+        bool ok = r.ec == std::errc() && r.ptr < end && *r.ptr == ',';
+        if (ok) {
+            r = std::from_chars(r.ptr + 1, end, id);
+            ok = r.ec == std::errc() && r.ptr < end && *r.ptr == ',';
+        }
+        for (int k = 0; ok && k < 4; ++k) {
+            r = std::from_chars(r.ptr + 1, end, v[k]);
+            ok = r.ec == std::errc() &&
+                 (k < 3 ? r.ptr < end && *r.ptr == ','
+                        : r.ptr == end || *r.ptr == ',' || *r.ptr == '\n' || *r.ptr == '\r');
+        }
+        if (!ok) return {line, "malformed row"};
+        if (rowStep != step) return {line, "rows are not ordered by step"};
+        if (id < 0 || id >= config.N) return {line, "id out of range for --N"};
+        if (seen[id].exchange(1, std::memory_order_relaxed)) return {line, "duplicate id"};
+
+        particles[id] = Particle(v[0], v[1], v[2], v[3], config.radius, id);
+        count++;
+    }
+    return {};
+}
+
+bool loadCsv(const std::string& path, const SimConfig& config, std::vector<Particle>& particles) {
+    MappedFile file(path);
+    if (!file.begin()) {
+        std::cerr << "Error: Could not read " << path << std::endl;
+        return false;
+    }
+    const char* begin = file.begin();
+    const char* end = file.end();
+    if (!std::isdigit(static_cast<unsigned char>(*begin))) {
+        begin = nextLine(begin, end);  // Header
+    }
+
+    // The last step is the one on the final line; rows are ordered by step,
+    // so its rows are the tail of the file, found by bisection
+    const char* last = end;
+    while (last > begin && (last[-1] == '\n' || last[-1] == '\r')) --last;
+    const char* lastLine = last;
+    while (lastLine > begin && lastLine[-1] != '\n') --lastLine;
+    const long step = stepAt(lastLine, last);
+    if (last == begin || step < 0) {
+        std::cerr << "Error: No rows in " << path << std::endl;
+        return false;
+    }
+    const char* lo = begin;
+    const char* hi = lastLine;
+    while (static_cast<size_t>(hi - lo) > kLinearScanBytes) {
+        const char* mid = nextLine(lo + (hi - lo) / 2, hi);
+        if (mid >= hi) break;
+        if (stepAt(mid, end) < step) lo = mid; else hi = mid;
+    }
+    while (lo < hi && stepAt(lo, end) < step) lo = nextLine(lo, hi);
+    const char* start = lo;
+
+    // Newline-aligned chunks, parsed in parallel straight into place
+    const size_t bytes = end - start;
+    const int chunks = static_cast<int>(std::max<size_t>(1, std::min<size_t>(
+        bytes / kMinChunkBytes, static_cast<size_t>(resolveThreads(config.threads)) * 4)));
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = start;
+    for (int c = 1; c < chunks; ++c) {
+        const char* p = start + bytes * c / chunks;
+        bounds[c] = p[-1] == '\n' ? p : nextLine(p, end);
+    }
+
+    particles.assign(config.N, Particle());
+    std::unique_ptr<std::atomic<uint8_t>[]> seen(new std::atomic<uint8_t>[config.N]());
+    std::vector<CsvError> errors(chunks);
+    std::vector<int> counts(chunks, 0);
+    parallelFor(chunks, config.threads, [&](int c) {
+        errors[c] = parseRows(bounds[c], bounds[c + 1], step, config, seen.get(), particles, counts[c]);
+    });
+
+    for (const auto& e : errors) {
+        if (e.at) {
+            long line = 1 + std::count(file.begin(), e.at, '\n');
+            std::cerr << "Error: " << path << ":" << line << ": " << e.what << std::endl;
+            return false;
+        }
+    }
+    int count = 0;
+    for (int n : counts) count += n;
+    if (count != config.N) {
+        std::cerr << "Error: " << path << " holds " << count << " particles at step " << step
+                  << ", run has N=" << config.N << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool checkParticles(const std::string& path, const SimConfig& config, const std::vector<Particle>& particles) {
+    for (const auto& p : particles) {
+        bool finite = std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.vx) && std::isfinite(p.vy);
+        if (!finite || p.x < 0.0f || p.x > config.box_w || p.y < 0.0f || p.y > config.box_h) {
+            std::cerr << "Error: Particle " << p.id << " in " << path << " is at (" << p.x << ", " << p.y
+                      << ") with velocity (" << p.vx << ", " << p.vy << "), outside the "
+                      << config.box_w << "x" << config.box_h << " box or not finite" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+bool loadInitialParticles(const std::string& path, const SimConfig& config, std::vector<Particle>& particles) {
+    char magic[8] = {};
+    std::ifstream probe(path, std::ios::binary);
+    if (!probe.is_open()) {
+        std::cerr << "Error: Could not open " << path << std::endl;
+        return false;
+    }
+    probe.read(magic, sizeof(magic));
+    probe.close();
+
+    bool ok;
+    if (checkpoint::isCheckpoint(path)) {
+        ok = checkpoint::readParticles(path, config, particles);
+    } else if (std::memcmp(magic, "PBTRAJ1", 8) == 0) {
+        ok = loadTrajectory(path, config, particles);
+    } else if (std::memcmp(magic, "PBDTRJ1", 8) == 0) {
+        ok = loadDeltaTrajectory(path, config, particles);
+    } else {
+        ok = loadCsv(path, config, particles);
+    }
+    return ok && checkParticles(path, config, particles);
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "particle.hpp"
+#include "sim_config.hpp"
+#include <string>
+#include <vector>
+
+// --init: particles from an earlier run or another tool, in place of
+// initializeParticles(). The format is recognised by the file's magic:
+//   checkpoint.bin  the snapshot's particles (N, radius and box must match)
+//   steps.bin       the last frame, read from the mapped file
+//   steps.dtraj     the last frame, decoded from the last keyframe on
+//   anything else   CSV in the steps.csv layout (step,id,x,y,vx,vy[,collided],
+//                   optional header, rows ordered by step); the rows of the
+//                   last step are parsed with std::from_chars on --threads
+// The file must hold ids 0..N-1 once each, with finite values and positions
+// inside the box. Fails with a message on stderr.
+bool loadInitialParticles(const std::string& path, const SimConfig& config, std::vector<Particle>& particles);
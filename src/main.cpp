@@ -2,11 +2,23 @@
 #include "sim_config.hpp"
 #include "particle.hpp"
 #include "physics.hpp"
-#include "engine_quadtree.hpp"
-#include "engine_hash.hpp"
+#include "engine.hpp"
 #include "rng.hpp"
+#include "init.hpp"
+#include "init_file.hpp"
+#include "scaling.hpp"
+#include "autotune.hpp"
+#include "broadphase_verify.hpp"
 #include "metrics.hpp"
 #include "csv.hpp"
+#include "trajectory.hpp"
+#include "delta_trajectory.hpp"
+#include "checkpoint.hpp"
+#include "pair_log.hpp"
+#include "shm_stream.hpp"
+#include "perf_counters.hpp"
+#include "trace.hpp"
+#include "metrics_server.hpp"
 #include <iostream>
 #include <vector>
 #include <algorithm>
@@ -17,59 +29,13 @@
 #include <chrono>
 #include <memory>
 #include <cstdlib>
+#include <cstdio>
 
 #ifdef WITH_SFML
 #include "render.hpp"
 #endif
 
-// Initialize particles with random non-overlapping positions
-std::vector<Particle> initializeParticles(const SimConfig& config, RNG& rng) {
-    std::vector<Particle> particles;
-    particles.reserve(config.N);
-    
-    int attempts = 0;
-    const int maxAttempts = 1000;
-    
-    for (int i = 0; i < config.N; ++i) {
-        float x, y;
-        bool valid = false;
-        
-        attempts = 0;
-        while (!valid && attempts < maxAttempts) {
-            x = rng.uniform(config.radius, config.box_w - config.radius);
-            y = rng.uniform(config.radius, config.box_h - config.radius);
-            
-            valid = true;
-            for (const auto& existing : particles) {
-                float dx = x - existing.x;
-                float dy = y - existing.y;
-                float dist_sq = dx * dx + dy * dy;
-                float r_sum = 2 * config.radius;
-                if (dist_sq < r_sum * r_sum) {
-                    valid = false;
-                    break;
-                }
-            }
-            attempts++;
-        }
-        
-        if (!valid) {
-            std::cerr << "Warning: Could not place particle " << i << " after " << maxAttempts << " attempts" << std::endl;
-        }
-        
-        // Random velocity in bounded range (increased for more collisions)
-        float speed = rng.uniform(400.0f, 600.0f);
-        float angle = rng.uniform(0.0f, 2.0f * 3.14159265359f);
-        float vx = speed * std::cos(angle);
-        float vy = speed * std::sin(angle);
-        
-        particles.emplace_back(x, y, vx, vy, config.radius, i);
-    }
-    
-    return particles;
-}
-
-void writeMetadata(const SimConfig& config, const std::string& outdir) {
+void writeMetadata(const SimConfig& config, const std::string& outdir, const std::string& engineParams) {
     std::ostringstream oss;
     oss << outdir << "/run_meta.json";
     std::ofstream file(oss.str());
@@ -85,70 +51,441 @@ void writeMetadata(const SimConfig& config, const std::string& outdir) {
          << "  \"dt\": " << config.dt << ",\n"
          << "  \"steps\": " << config.steps << ",\n"
          << "  \"method\": \"" << config.method << "\",\n"
+         << "  \"format\": \"" << config.format << "\",\n"
+         << "  \"init_mode\": \"" << config.init_mode << "\",\n"
+         << "  \"autotune\": " << (config.autotune ? "true" : "false") << ",\n"
+         << "  \"ccd\": " << (config.ccd ? "true" : "false") << ",\n"
+         << "  \"engine_params\": \"" << engineParams << "\",\n"
          << "  \"start_time\": \"" << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") << "\"\n"
          << "}\n";
 }
 
+// broadphase.csv columns depend on the structure the engine builds
+void writeBroadphaseHeader(CSVWriter& writer, BroadphaseStats::Kind kind) {
+    writer.field("step");
+    if (kind == BroadphaseStats::Kind::Quadtree) {
+        for (const char* column : {"nodes", "leaves", "max_depth", "internal_bodies", "max_leaf_bodies"}) {
+            writer.field(column);
+        }
+    } else {
+        for (const char* column : {"table_size", "occupied_cells", "resizes", "avg_probe", "max_probe",
+                                   "max_cell_bodies"}) {
+            writer.field(column);
+        }
+    }
+    for (int b = 0; b < BroadphaseStats::kOccupancyBins; ++b) {
+        bool last = b == BroadphaseStats::kOccupancyBins - 1;
+        writer.field("occ_" + std::to_string(b) + (last ? "plus" : ""));
+    }
+    writer.endRow();
+}
+
+void writeBroadphaseRow(CSVWriter& writer, int step, const BroadphaseStats& stats) {
+    writer.field(step);
+    if (stats.kind == BroadphaseStats::Kind::Quadtree) {
+        writer.field(stats.nodes).field(stats.buckets).field(stats.maxDepth)
+              .field(stats.internalBodies).field(stats.maxOccupancy);
+    } else {
+        writer.field(stats.tableSize).field(stats.buckets).field(stats.resizes)
+              .field(stats.avgProbe(), 3).field(stats.maxProbe).field(stats.maxOccupancy);
+    }
+    for (uint64_t count : stats.occupancy) {
+        writer.field(count);
+    }
+    writer.endRow();
+}
+
+// Column names of summary.csv, in row order
+std::vector<std::string> summaryColumns() {
+    std::vector<std::string> columns = {"method", "N", "dt", "steps", "steps_per_sec",
+                                        "cand_per_particle", "p50_ms", "p95_ms",
+                                        "energy_drift_median", "energy_drift_max",
+                                        "seed", "box_w", "box_h", "radius",
+                                        "p99_ms", "p999_ms", "max_ms"};
+    // Per-phase latency and counter columns, e.g. integrate_p50_ms
+    for (int ph = 0; ph < kPhaseCount; ++ph) {
+        std::string name = phaseName(static_cast<Phase>(ph));
+        for (const char* stat : {"_p50_ms", "_p95_ms", "_p99_ms", "_max_ms"}) {
+            columns.push_back(name + stat);
+        }
+    }
+    for (int ph = 0; ph < kPhaseCount; ++ph) {
+        std::string name = phaseName(static_cast<Phase>(ph));
+        for (const char* stat : {"_ipc", "_l1_miss_per_particle", "_llc_miss_per_particle",
+                                 "_branch_miss_rate"}) {
+            columns.push_back(name + stat);
+        }
+    }
+    // Broad-phase structure (--broadphase_stats), averaged over steps
+    for (const char* column : {"bp_nodes_mean", "bp_leaves_mean", "bp_max_depth", "bp_internal_bodies_mean",
+                               "bp_occupied_cells_mean", "bp_avg_probe", "bp_max_probe", "bp_resizes",
+                               "bp_bodies_per_bucket_mean", "bp_max_bodies_per_bucket"}) {
+        columns.push_back(column);
+    }
+    for (const char* column : {"bytes_per_particle", "peak_rss_mb", "mem_particles_mb", "mem_broadphase_mb",
+                               "mem_scratch_mb", "mem_output_mb", "engine_params", "engine_changes",
+                               "verify_steps", "verify_missed_pairs"}) {
+        columns.push_back(column);
+    }
+    return columns;
+}
+
+// Append one row to <outdir>/summary.csv, writing the header for a new file.
+// A summary.csv with other columns (written by another version) is moved
+// aside to summary.old<k>.csv rather than appended to with misaligned rows.
+std::string writeSummary(const SimConfig& config, const Metrics& metrics, int steps,
+                         const std::string& engineParams) {
+    std::string summaryFile = config.outdir + "/summary.csv";
+    std::vector<std::string> columns = summaryColumns();
+    std::string header;
+    for (const auto& column : columns) {
+        header += (header.empty() ? "" : ",") + column;
+    }
+    
+    std::string existingHeader;
+    bool summaryExists = false;
+    {
+        std::ifstream existing(summaryFile);
+        summaryExists = std::getline(existing, existingHeader).good() || !existingHeader.empty();
+    }
+    if (summaryExists && existingHeader != header) {
+        std::string aside;
+        for (int k = 1; ; ++k) {
+            aside = config.outdir + "/summary.old" + std::to_string(k) + ".csv";
+            if (!std::ifstream(aside).good()) break;
+        }
+        if (std::rename(summaryFile.c_str(), aside.c_str()) != 0) {
+            std::cerr << "Error: " << summaryFile << " has different columns and could not be moved to "
+                      << aside << "; summary not written" << std::endl;
+            return summaryFile;
+        }
+        std::cerr << "Warning: " << summaryFile << " has different columns; moved it to " << aside << std::endl;
+        summaryExists = false;
+    }
+    CSVWriter summaryWriter(summaryFile, true);  // Append mode
+    
+    if (!summaryExists) {
+        summaryWriter.writeRow(columns);
+    }
+    
+    summaryWriter.field(config.method)
+                 .field(config.N)
+                 .field(config.dt)
+                 .field(steps)
+                 .field(metrics.steps_per_sec)
+                 .field(metrics.cand_per_particle)
+                 .field(metrics.p50_ms)
+                 .field(metrics.p95_ms);
+    if (config.no_energy) {
+        summaryWriter.field("0.0").field("0.0");
+    } else {
+        summaryWriter.fieldSci(metrics.energy_drift_median).fieldSci(metrics.energy_drift_max);
+    }
+    summaryWriter.field(config.seed)
+                 .field(config.box_w)
+                 .field(config.box_h)
+                 .field(config.radius)
+                 .field(metrics.p99_ms)
+                 .field(metrics.p999_ms)
+                 .field(metrics.max_ms);
+    for (const auto& stats : metrics.phase_stats) {
+        summaryWriter.field(stats.p50_ms, 4)
+                     .field(stats.p95_ms, 4)
+                     .field(stats.p99_ms, 4)
+                     .field(stats.max_ms, 4);
+    }
+    // Counter columns stay empty without --perf_counters or when an event is missing
+    for (const auto& perf : metrics.phase_perf) {
+        for (double value : {perf.ipc, perf.l1_miss_per_particle, perf.llc_miss_per_particle,
+                             perf.branch_miss_rate}) {
+            if (std::isnan(value)) {
+                summaryWriter.field("");
+            } else {
+                summaryWriter.field(value, 4);
+            }
+        }
+    }
+    // Broad-phase columns that do not apply to the method stay empty
+    const BroadphaseStats& bp = metrics.broadphaseTotals();
+    double bpSteps = static_cast<double>(std::max<uint64_t>(metrics.broadphaseSteps(), 1));
+    bool isTree = bp.kind == BroadphaseStats::Kind::Quadtree;
+    bool isHash = bp.kind == BroadphaseStats::Kind::Hash;
+    auto optional = [&summaryWriter](bool applies, double value, int precision) {
+        if (applies) {
+            summaryWriter.field(value, precision);
+        } else {
+            summaryWriter.field("");
+        }
+    };
+    optional(isTree, bp.nodes / bpSteps, 1);
+    optional(isTree, bp.buckets / bpSteps, 1);
+    optional(isTree, static_cast<double>(bp.maxDepth), 0);
+    optional(isTree, bp.internalBodies / bpSteps, 2);
+    optional(isHash, bp.buckets / bpSteps, 1);
+    optional(isHash, bp.avgProbe(), 3);
+    optional(isHash, static_cast<double>(bp.maxProbe), 0);
+    optional(isHash, static_cast<double>(bp.resizes), 0);
+    optional(isTree || isHash, bp.meanOccupancy(), 3);
+    optional(isTree || isHash, static_cast<double>(bp.maxOccupancy), 0);
+    const MemoryStats& mem = metrics.peak_memory;
+    summaryWriter.field(metrics.bytes_per_particle, 1)
+                 .field(metrics.peak_rss_mb, 2)
+                 .field(mem.particles / 1048576.0, 3)
+                 .field(mem.broadphase / 1048576.0, 3)
+                 .field(mem.scratch / 1048576.0, 3)
+                 .field(mem.output / 1048576.0, 3)
+                 .field(engineParams)
+                 .field(static_cast<int>(metrics.engineChanges().size()));
+    optional(config.verify_broadphase > 0, static_cast<double>(metrics.verifySteps()), 0);
+    optional(config.verify_broadphase > 0, static_cast<double>(metrics.verifyMissed()), 0);
+    summaryWriter.endRow();
+    summaryWriter.flush(); // Ensure it's written to disk
+    return summaryFile;
+}
+
 int main(int argc, char* argv[]) {
     SimConfig config = CLI::parse(argc, argv);
     
+    // Offline conversion mode
+    if (!config.export_pairs.empty()) {
+        std::string csvFile = config.export_pairs;
+        if (csvFile.size() > 4 && csvFile.compare(csvFile.size() - 4, 4, ".bin") == 0) {
+            csvFile.resize(csvFile.size() - 4);
+        }
+        csvFile += ".csv";
+        return PairLog::exportCSV(config.export_pairs, csvFile) ? 0 : 1;
+    }
+    
     // Create output directory
     std::string cmd = "mkdir -p " + config.outdir;
     system(cmd.c_str());
     
+    // Scaling sweep mode
+    if (!config.scaling.empty()) {
+        return runScaling(config);
+    }
+    
     // Initialize RNG
     RNG rng(config.seed);
     
-    // Initialize particles
-    std::vector<Particle> particles = initializeParticles(config, rng);
-    
-    // Write metadata
-    writeMetadata(config, config.outdir);
+    // Resume state from a checkpoint, if requested
+    CheckpointState restored;
+    bool restarting = !config.restart.empty();
+    if (restarting) {
+        if (!checkpoint::load(config.restart, config, restored) || !rng.load(restored.rngState)) {
+            return 1;
+        }
+    }
     
-    // Create engine based on method
-    std::unique_ptr<EngineQuadtree> engine_quadtree;
-    std::unique_ptr<EngineHash> engine_hash;
+    if (!isInitMode(config.init_mode)) {
+        std::cerr << "Error: Unknown init mode: " << config.init_mode << std::endl;
+        return 1;
+    }
     
-    if (config.method == "quadtree") {
-        engine_quadtree = std::make_unique<EngineQuadtree>(config.box_w, config.box_h, config.radius);
-    } else if (config.method == "hash") {
-        engine_hash = std::make_unique<EngineHash>(config.box_w, config.box_h, config.radius);
+    // Initialize particles
+    std::vector<Particle> particles;
+    if (restarting) {
+        particles = std::move(restored.particles);
+    } else if (!config.init_file.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        if (!loadInitialParticles(config.init_file, config, particles)) {
+            return 1;
+        }
+        std::cout << "Loaded " << particles.size() << " particles from " << config.init_file << " in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s"
+                  << std::endl;
     } else {
+        particles = initializeParticles(config, rng);
+    }
+    
+    // Create engine based on method
+    EngineParams baseParams;
+    baseParams.autoProbeEvery = config.auto_probe_every;
+    baseParams.threads = config.threads;
+    baseParams.ccd = config.ccd;
+    std::unique_ptr<Engine> engine = makeEngine(config.method, config.box_w, config.box_h, config.radius, baseParams);
+    if (!engine) {
         std::cerr << "Error: Unknown method: " << config.method << std::endl;
         return 1;
     }
+    if (config.ccd && (config.method == "brute" || config.method == "event")) {
+        std::cerr << "Warning: --ccd has no effect with --method " << config.method << std::endl;
+    }
+    
+    // Broad-phase parameters: as checkpointed, or timed over a grid (--autotune)
+    double clusteringAtTune = 0.0;
+    if (restarting) {
+        engine = makeEngine(config.method, config.box_w, config.box_h, config.radius, restored.engineParams);
+        clusteringAtTune = restored.clusteringSignature;
+        if (!engine->loadState(restored.engineState)) {
+            std::cerr << "Error: Corrupt engine section in checkpoint: " << config.restart << std::endl;
+            return 1;
+        }
+    } else if (config.autotune) {
+        AutotuneResult tuned = autotune(config.method, particles, config.box_w, config.box_h, config.radius,
+                                        config.dt, config.autotune_steps, baseParams);
+        clusteringAtTune = clusteringSignature(particles, config.box_w, config.box_h);
+        if (tuned.trials == 0) {
+            std::cout << "Autotune: nothing to tune for --method " << config.method << std::endl;
+        } else {
+            engine = makeEngine(config.method, config.box_w, config.box_h, config.radius, tuned.params);
+            std::cout << "Autotune: " << tuned.trials << " settings, picked " << engine->describeParams()
+                      << " (" << std::fixed << std::setprecision(3) << tuned.bestMs << " ms/step vs "
+                      << tuned.defaultMs << " with defaults)" << std::defaultfloat << std::endl;
+        }
+    }
+    
+    // Write metadata
+    writeMetadata(config, config.outdir, engine->describeParams());
     
     // Metrics
-    Metrics metrics;
+    Metrics metrics(config.hist_digits);
+    
+    // Hardware counters per phase (optional, Linux only)
+    PerfCounters perfCounters;
+    if (config.perf_counters && perfCounters.open()) {
+        engine->setPerfCounters(&perfCounters);
+        metrics.enablePerfCounters(perfCounters.eventMask());
+    }
     metrics.setN(config.N);
+    if (restarting && !metrics.load(restored.metricsState)) {
+        std::cerr << "Error: Corrupt metrics section in checkpoint: " << config.restart << std::endl;
+        return 1;
+    }
     
-    // CSV writers
+    if (config.format != "csv" && config.format != "bin" && config.format != "delta") {
+        std::cerr << "Error: Unknown format: " << config.format << std::endl;
+        return 1;
+    }
+    
+    // Timeline trace; started before the writers so their threads are named
+    if (!config.trace.empty()) {
+        trace::start();
+        trace::setThreadName("main");
+    }
+    
+    // Output writers
     CSVWriter* stepsWriter = nullptr;
-    CSVWriter* pairsWriter = nullptr;
+    TrajectoryWriter* trajectoryWriter = nullptr;
+    DeltaTrajectoryWriter* deltaWriter = nullptr;
+    PairLog* pairLog = nullptr;
+    CSVWriter* phasesWriter = nullptr;
+    CSVWriter* broadphaseWriter = nullptr;
+    CSVWriter* verifyWriter = nullptr;
     
     if (!config.summary_only) {
-        std::ostringstream stepsFile;
-        stepsFile << config.outdir << "/steps.csv";
-        stepsWriter = new CSVWriter(stepsFile.str());
-        stepsWriter->writeRow({"step", "id", "x", "y", "vx", "vy", "collided"});
+        if (config.format == "bin") {
+            std::ostringstream stepsFile;
+            stepsFile << config.outdir << "/steps.bin";
+            trajectoryWriter = new TrajectoryWriter(stepsFile.str(), config.N, config.dt,
+                                                    config.box_w, config.box_h, config.radius,
+                                                    config.seed, restarting);
+        } else if (config.format == "delta") {
+            std::ostringstream stepsFile;
+            stepsFile << config.outdir << "/steps.dtraj";
+            deltaWriter = new DeltaTrajectoryWriter(stepsFile.str(), config.N, config.dt,
+                                                    config.box_w, config.box_h, config.radius,
+                                                    config.seed, config.keyframe_every,
+                                                    config.quant_bits, restarting);
+        } else {
+            std::ostringstream stepsFile;
+            stepsFile << config.outdir << "/steps.csv";
+            stepsWriter = new CSVWriter(stepsFile.str(), restarting);
+            if (!restarting) {
+                stepsWriter->writeRow({"step", "id", "x", "y", "vx", "vy", "collided"});
+            }
+        }
+        
+        phasesWriter = new CSVWriter(config.outdir + "/phases.csv", restarting);
+        if (!restarting) {
+            phasesWriter->field("step");
+            for (int ph = 0; ph < kPhaseCount; ++ph) {
+                phasesWriter->field(std::string(phaseName(static_cast<Phase>(ph))) + "_ms");
+            }
+            phasesWriter->endRow();
+        }
+        
+        if (config.broadphase_stats) {
+            broadphaseWriter = new CSVWriter(config.outdir + "/broadphase.csv", restarting);
+            if (!restarting || restored.broadphaseOutputState.empty()) {
+                BroadphaseStats kindProbe;
+                engine->collectBroadphaseStats(kindProbe);
+                writeBroadphaseHeader(*broadphaseWriter, kindProbe.kind);
+            }
+        }
         
         if (config.log_pairs) {
             std::ostringstream pairsFile;
-            pairsFile << config.outdir << "/pairs.csv";
-            pairsWriter = new CSVWriter(pairsFile.str());
-            pairsWriter->writeRow({"step", "i", "j", "tested", "collided"});
+            pairsFile << config.outdir << "/pairs.bin";
+            pairLog = new PairLog(pairsFile.str(), config.N, config.seed, config.log_pairs_sample,
+                                  restarting);
+            engine->setPairLog(pairLog);
+        }
+    }
+    
+    // Missed pairs are written even with --summary_only; they are the point of the check
+    if (config.verify_broadphase > 0) {
+        verifyWriter = new CSVWriter(config.outdir + "/broadphase_misses.csv", restarting);
+        if (!restarting || restored.verifyOutputState.empty()) {
+            verifyWriter->writeRow({"step", "id_a", "id_b", "distance", "engine"});
+        }
+    }
+    
+    // Drop anything the interrupted run logged after its last checkpoint
+    if (restarting) {
+        bool ok = true;
+        if (stepsWriter) ok = ok && stepsWriter->restoreState(restored.stepsOutputState);
+        if (trajectoryWriter) ok = ok && trajectoryWriter->restoreState(restored.stepsOutputState);
+        if (deltaWriter) ok = ok && deltaWriter->restoreState(restored.stepsOutputState);
+        if (pairLog) ok = ok && pairLog->restoreState(restored.pairsOutputState);
+        if (phasesWriter) ok = ok && phasesWriter->restoreState(restored.phasesOutputState);
+        if (broadphaseWriter && !restored.broadphaseOutputState.empty()) {
+            ok = ok && broadphaseWriter->restoreState(restored.broadphaseOutputState);
+        }
+        if (verifyWriter && !restored.verifyOutputState.empty()) {
+            ok = ok && verifyWriter->restoreState(restored.verifyOutputState);
+        }
+        if (!ok) {
+            std::cerr << "Error: Could not rewind per-step logs to the checkpoint" << std::endl;
+            return 1;
         }
     }
     
     // Compute initial energy
     double initialEnergy = 0.0;
-    if (!config.no_energy) {
-        initialEnergy = static_cast<double>(physics::total_energy(particles));
+    if (restarting) {
+        initialEnergy = restored.initialEnergy;
+    } else if (!config.no_energy) {
+        initialEnergy = physics::total_energy(particles);
     }
     
-    // Track simulated time for energy recording (once per simulated second)
-    double simulatedTime = 0.0;
-    double lastEnergyRecordTime = 0.0;
+    // Energy comes out of the engine's walls and narrow passes, every step
+    double simulatedTime = restored.simulatedTime;
+    engine->setEnergyTracking(!config.no_energy);
+    metrics.set_initial_energy(initialEnergy);
+    
+    // Live Prometheus endpoint
+    std::unique_ptr<MetricsServer> metricsServer;
+    if (config.metrics_port > 0) {
+        metricsServer = std::make_unique<MetricsServer>(config.metrics_port, metrics, config.method, config.N);
+    }
+    
+    // Live snapshot stream
+    std::unique_ptr<ShmStreamWriter> streamWriter;
+    if (!config.stream.empty()) {
+        if (config.stream.rfind("shm:", 0) != 0 || config.stream.size() <= 4) {
+            std::cerr << "Error: Unknown stream target: " << config.stream << " (expected shm:<name>)" << std::endl;
+            return 1;
+        }
+        streamWriter = std::make_unique<ShmStreamWriter>(config.stream.substr(4), config.N, config.box_w,
+                                                         config.box_h, config.radius, config.dt);
+    }
+    
+    // Periodic checkpoints
+    std::unique_ptr<CheckpointWriter> checkpointWriter;
+    if (config.checkpoint_every > 0) {
+        checkpointWriter = std::make_unique<CheckpointWriter>(config.outdir + "/checkpoint.bin");
+    }
     
     // Rendering setup
 #ifdef WITH_SFML
@@ -164,68 +501,199 @@ int main(int argc, char* argv[]) {
         totalSteps = static_cast<int>(config.time_limit / config.dt);
     }
     
+    // Memory footprint, sampled every 64 steps and after the last one
+    auto sampleMemory = [&]() {
+        MemoryStats mem;
+        mem.particles = particles.capacity() * sizeof(Particle);
+        mem.broadphase = engine->broadphaseBytes();
+        mem.scratch = engine->scratchBytes();
+        if (stepsWriter) mem.output += stepsWriter->memoryBytes();
+        if (phasesWriter) mem.output += phasesWriter->memoryBytes();
+        if (broadphaseWriter) mem.output += broadphaseWriter->memoryBytes();
+        if (trajectoryWriter) mem.output += trajectoryWriter->memoryBytes();
+        if (deltaWriter) mem.output += deltaWriter->memoryBytes();
+        if (pairLog) mem.output += pairLog->memoryBytes();
+        metrics.record_memory(mem);
+    };
+    
+    // Re-tunes the broad phase when the particles have clustered or spread
+    // out since the last tuning; the new engine takes over from this step
+    auto maybeRetune = [&](int step) {
+        double clustering = clusteringSignature(particles, config.box_w, config.box_h);
+        if (std::abs(clustering - clusteringAtTune) <= 0.25 * clusteringAtTune) {
+            return;
+        }
+        std::ostringstream reason;
+        reason << "clustering " << std::setprecision(3) << clusteringAtTune << " -> " << clustering;
+        clusteringAtTune = clustering;
+        AutotuneResult tuned = autotune(config.method, particles, config.box_w, config.box_h, config.radius,
+                                        config.dt, config.autotune_steps, baseParams);
+        if (tuned.trials == 0) {
+            return;
+        }
+        std::unique_ptr<Engine> retuned = makeEngine(config.method, config.box_w, config.box_h, config.radius,
+                                                     tuned.params);
+        if (retuned->describeParams() == engine->describeParams()) {
+            return;
+        }
+        engine = std::move(retuned);
+        if (pairLog) engine->setPairLog(pairLog);
+        if (perfCounters.isOpen()) engine->setPerfCounters(&perfCounters);
+        engine->setEnergyTracking(!config.no_energy);
+        metrics.record_engine_change(step, config.method + " " + engine->describeParams(), reason.str());
+        std::cout << "Step " << step << ": re-tuned to " << engine->describeParams()
+                  << " (" << reason.str() << ")" << std::endl;
+    };
+    
+    CandidateCapture capture;  // --verify_broadphase
+    
     // Simulation loop
-    for (int step = 0; step < totalSteps; ++step) {
+    for (int step = restored.step; step < totalSteps; ++step) {
+        if (config.autotune_every > 0 && step > 0 && step % config.autotune_every == 0) {
+            maybeRetune(step);
+        }
+        
+        trace::setSampled(step % std::max(config.trace_sample, 1) == 0);
+        trace::Scope stepScope("step", "step");
+        
+        if (pairLog) {
+            pairLog->beginStep(step);
+        }
+        
+        // Sampled steps hand their broad-phase output over for checking
+        bool verifying = config.verify_broadphase > 0 && step % config.verify_broadphase == 0;
+        engine->setCandidateCapture(verifying ? &capture : nullptr);
+        
         // Begin step timing
         metrics.begin_step();
         
         // Step simulation
-        if (config.method == "quadtree") {
-            engine_quadtree->step(particles, config.dt);
-        } else {
-            engine_hash->step(particles, config.dt);
+        engine->step(particles, config.dt);
+        if (!engine->switchNote().empty()) {
+            metrics.record_engine_change(step, config.method + " " + engine->describeParams(), engine->switchNote());
+            std::cout << "Step " << step << ": switched to " << engine->describeParams()
+                      << " (" << engine->switchNote() << ")" << std::endl;
         }
         
         // Get candidate pairs checked this step
-        uint32_t candidatePairs = 0;
-        if (config.method == "quadtree") {
-            candidatePairs = static_cast<uint32_t>(engine_quadtree->getCandidatePairsChecked());
-        } else {
-            candidatePairs = static_cast<uint32_t>(engine_hash->getCandidatePairsChecked());
-        }
+        uint32_t candidatePairs = static_cast<uint32_t>(engine->getCandidatePairsChecked());
         
         // End step and record candidates
         metrics.end_step(candidatePairs);
+        metrics.record_phases(engine->getPhaseTimes());
+        
+        // Structure statistics walk the broad phase after the timed step
+        BroadphaseStats broadphaseStats;
+        if (config.broadphase_stats) {
+            engine->collectBroadphaseStats(broadphaseStats);
+            metrics.record_broadphase(broadphaseStats);
+        }
         
         // Record collisions
-        int collisions = 0;
-        if (config.method == "quadtree") {
-            collisions = engine_quadtree->getCollisionsThisStep();
-        } else {
-            collisions = engine_hash->getCollisionsThisStep();
+        metrics.recordCollisions(engine->getCollisionsThisStep());
+        
+        if (verifying) {
+            trace::Scope verifyScope("verify_broadphase", "verify");
+            VerifyResult result = verifyCandidates(capture, config.threads);
+            metrics.record_verification(result.overlapping, result.missed.size());
+            if (!result.missed.empty()) {
+                std::string engineName = config.method + " " + engine->describeParams();
+                for (const auto& miss : result.missed) {
+                    verifyWriter->field(step).field(miss.a).field(miss.b).field(miss.distance, 4)
+                                 .field(engineName).endRow();
+                }
+                const MissedPair& first = result.missed.front();
+                std::cerr << "Step " << step << ": broad phase missed " << result.missed.size() << " of "
+                          << result.overlapping << " overlapping pairs (e.g. " << first.a << "-" << first.b
+                          << " at distance " << first.distance << ")" << std::endl;
+            }
         }
-        metrics.recordCollisions(collisions);
         
-        // Record energy once per simulated second
+        if (pairLog) {
+            pairLog->endStep();
+        }
+        
+        if ((step + 1) % 64 == 0 || step + 1 == totalSteps) {
+            sampleMemory();
+        }
+        
+        simulatedTime += config.dt;
         if (!config.no_energy) {
-            simulatedTime += config.dt;
-            if (simulatedTime - lastEnergyRecordTime >= 1.0) {
-                double currentEnergy = static_cast<double>(physics::total_energy(particles));
-                metrics.record_energy(currentEnergy);
-                lastEnergyRecordTime = simulatedTime;
-            }
+            const physics::StepEnergy& energy = engine->getStepEnergy();
+            metrics.record_energy(energy.kinetic.value(), energy.momentumX.value(), energy.momentumY.value());
         }
         
         // Log step data (if not summary_only)
-        if (!config.summary_only && stepsWriter) {
-            for (const auto& p : particles) {
-                std::vector<std::string> row = {
-                    std::to_string(step),
-                    std::to_string(p.id),
-                    std::to_string(p.x),
-                    std::to_string(p.y),
-                    std::to_string(p.vx),
-                    std::to_string(p.vy),
-                    std::to_string(p.collided ? 1 : 0)
-                };
-                stepsWriter->writeRow(row);
+        if (!config.summary_only) {
+            trace::Scope writeScope("write_steps", "io");
+            if (stepsWriter) {
+                for (const auto& p : particles) {
+                    stepsWriter->field(step)
+                                .field(p.id)
+                                .field(p.x)
+                                .field(p.y)
+                                .field(p.vx)
+                                .field(p.vy)
+                                .field(p.collided ? 1 : 0);
+                    stepsWriter->endRow();
+                }
+            }
+            if (phasesWriter) {
+                const PhaseTimes& times = engine->getPhaseTimes();
+                phasesWriter->field(step);
+                for (int ph = 0; ph < kPhaseCount; ++ph) {
+                    phasesWriter->field(times.ms[ph], 4);
+                }
+                phasesWriter->endRow();
+            }
+            if (broadphaseWriter) {
+                writeBroadphaseRow(*broadphaseWriter, step, broadphaseStats);
+            }
+            if (trajectoryWriter) {
+                trajectoryWriter->writeFrame(step, particles);
+            }
+            if (deltaWriter) {
+                deltaWriter->writeFrame(step, particles);
             }
         }
         
+        if (streamWriter && (step + 1) % std::max(config.stream_every, 1) == 0) {
+            trace::Scope publishScope("stream_publish", "io");
+            streamWriter->publish(step, (step + 1) * static_cast<double>(config.dt), particles);
+        }
+        
+        // Checkpoint: snapshot in memory here, write to disk in the background
+        if (checkpointWriter && (step + 1) % config.checkpoint_every == 0) {
+            trace::Scope checkpointScope("checkpoint_snapshot", "io");
+            CheckpointState state;
+            state.step = step + 1;
+            state.simulatedTime = simulatedTime;
+            state.initialEnergy = initialEnergy;
+            state.rngState = rng.save();
+            state.metricsState = metrics.save();
+            if (stepsWriter) state.stepsOutputState = stepsWriter->saveState();
+            if (trajectoryWriter) state.stepsOutputState = trajectoryWriter->saveState();
+            if (deltaWriter) state.stepsOutputState = deltaWriter->saveState();
+            if (pairLog) state.pairsOutputState = pairLog->saveState();
+            if (phasesWriter) state.phasesOutputState = phasesWriter->saveState();
+            if (broadphaseWriter) state.broadphaseOutputState = broadphaseWriter->saveState();
+            if (verifyWriter) state.verifyOutputState = verifyWriter->saveState();
+            state.engineParams = engine->params();
+            state.clusteringSignature = clusteringAtTune;
+            state.engineState = engine->saveState();
+            state.particles = particles;
+            checkpointWriter->submit(checkpoint::serialize(config, state));
+        }
+        
         // Render
 #ifdef WITH_SFML
         if (renderWindow && !config.headless) {
-            if (!renderWindow->update(particles, metrics, step)) {
+            bool open;
+            {
+                trace::Scope renderScope("render", "render");
+                open = renderWindow->update(particles, metrics, step);
+            }
+            if (!open) {
                 break; // Window closed
             }
             
@@ -242,57 +710,19 @@ int main(int argc, char* argv[]) {
                 double finalEnergy = 0.0;
                 double energyDrift = 0.0;
                 if (!config.no_energy) {
-                    finalEnergy = static_cast<double>(physics::total_energy(particles));
+                    finalEnergy = physics::total_energy(particles);
                     energyDrift = (finalEnergy - initialEnergy) / initialEnergy;
                 }
                 
                 // Write summary CSV before loading other method
-                std::ostringstream summaryFile;
-                summaryFile << config.outdir << "/summary.csv";
-                bool summaryExists = std::ifstream(summaryFile.str()).good();
-                CSVWriter summaryWriter(summaryFile.str(), true);  // Append mode
-                
-                if (!summaryExists) {
-                    summaryWriter.writeRow({"method", "N", "dt", "steps", "steps_per_sec", 
-                                           "cand_per_particle", "p50_ms", "p95_ms", 
-                                           "energy_drift_median", "energy_drift_max", 
-                                           "seed", "box_w", "box_h", "radius"});
-                }
-                
-                std::ostringstream energyMedianStr, energyMaxStr;
-                if (config.no_energy) {
-                    energyMedianStr << "0.0";
-                    energyMaxStr << "0.0";
-                } else {
-                    energyMedianStr << std::scientific << std::setprecision(6) << metrics.energy_drift_median;
-                    energyMaxStr << std::scientific << std::setprecision(6) << metrics.energy_drift_max;
-                }
-                
-                std::vector<std::string> summaryRow = {
-                    config.method,
-                    std::to_string(config.N),
-                    std::to_string(config.dt),
-                    std::to_string(step),
-                    std::to_string(metrics.steps_per_sec),
-                    std::to_string(metrics.cand_per_particle),
-                    std::to_string(metrics.p50_ms),
-                    std::to_string(metrics.p95_ms),
-                    energyMedianStr.str(),
-                    energyMaxStr.str(),
-                    std::to_string(config.seed),
-                    std::to_string(config.box_w),
-                    std::to_string(config.box_h),
-                    std::to_string(config.radius)
-                };
-                summaryWriter.writeRow(summaryRow);
-                summaryWriter.flush(); // Ensure it's written to disk
+                std::string summaryFile = writeSummary(config, metrics, step, engine->describeParams());
                 
                 // Show results screen
                 renderWindow->showResults(metrics, step, config.N, config.dt, energyDrift,
                                         config.seed, config.box_w, config.box_h, config.radius);
                 
                 // Try to load other method's data from summary.csv (after writing)
-                renderWindow->loadOtherMethodFromCSV(summaryFile.str());
+                renderWindow->loadOtherMethodFromCSV(summaryFile);
                 
                 // Keep window open and show results screen
                 while (renderWindow->isWindowOpen() && renderWindow->getState() == RenderWindow::State::RESULTS) {
@@ -315,67 +745,38 @@ int main(int argc, char* argv[]) {
 #endif
     }
     
+    trace::setSampled(false);
+    
     // Finalize metrics
     double simTime = totalSteps * config.dt;
     metrics.finalize(simTime, initialEnergy);
     
     // Write summary CSV first (before showing results)
-    std::ostringstream summaryFile;
-    summaryFile << config.outdir << "/summary.csv";
-    bool summaryExists = std::ifstream(summaryFile.str()).good();
-    CSVWriter summaryWriter(summaryFile.str(), true);  // Append mode
+    std::string summaryFile = writeSummary(config, metrics, totalSteps, engine->describeParams());
     
-    if (!summaryExists) {
-        // Write header
-        summaryWriter.writeRow({"method", "N", "dt", "steps", "steps_per_sec", 
-                               "cand_per_particle", "p50_ms", "p95_ms", 
-                               "energy_drift_median", "energy_drift_max", 
-                               "seed", "box_w", "box_h", "radius"});
+    // Engine switches and re-tunes, one row each
+    if (!metrics.engineChanges().empty()) {
+        CSVWriter changes(config.outdir + "/engine_changes.csv");
+        changes.writeRow({"step", "engine", "reason"});
+        for (const auto& change : metrics.engineChanges()) {
+            changes.field(change.step).field(change.engine).field(change.reason).endRow();
+        }
     }
     
-    // Write summary row
-    std::ostringstream energyMedianStr, energyMaxStr;
-    if (config.no_energy) {
-        energyMedianStr << "0.0";
-        energyMaxStr << "0.0";
-    } else {
-        energyMedianStr << std::scientific << std::setprecision(6) << metrics.energy_drift_median;
-        energyMaxStr << std::scientific << std::setprecision(6) << metrics.energy_drift_max;
-    }
-    
-    std::vector<std::string> summaryRow = {
-        config.method,
-        std::to_string(config.N),
-        std::to_string(config.dt),
-        std::to_string(totalSteps),
-        std::to_string(metrics.steps_per_sec),
-        std::to_string(metrics.cand_per_particle),
-        std::to_string(metrics.p50_ms),
-        std::to_string(metrics.p95_ms),
-        energyMedianStr.str(),
-        energyMaxStr.str(),
-        std::to_string(config.seed),
-        std::to_string(config.box_w),
-        std::to_string(config.box_h),
-        std::to_string(config.radius)
-    };
-    summaryWriter.writeRow(summaryRow);
-    summaryWriter.flush(); // Ensure it's written to disk
-    
     // Show results screen if window is still open (after CSV is written)
 #ifdef WITH_SFML
     if (renderWindow && !config.headless && renderWindow->isWindowOpen()) {
         double finalEnergy = 0.0;
         double energyDrift = 0.0;
         if (!config.no_energy) {
-            finalEnergy = static_cast<double>(physics::total_energy(particles));
+            finalEnergy = physics::total_energy(particles);
             energyDrift = (finalEnergy - initialEnergy) / initialEnergy;
         }
         renderWindow->showResults(metrics, totalSteps, config.N, config.dt, energyDrift,
                                  config.seed, config.box_w, config.box_h, config.radius);
         
         // Try to load other method's data from summary.csv (after writing current results)
-        renderWindow->loadOtherMethodFromCSV(summaryFile.str());
+        renderWindow->loadOtherMethodFromCSV(summaryFile);
         
         // Keep window open to show results
         while (renderWindow->isWindowOpen() && renderWindow->getState() == RenderWindow::State::RESULTS) {
@@ -406,12 +807,41 @@ int main(int argc, char* argv[]) {
     }
     std::cout << std::endl;
     
+    if (config.verify_broadphase > 0) {
+        std::cout << "Broad-phase check: " << metrics.verifySteps() << " steps, "
+                  << metrics.verifyOverlapping() << " overlapping pairs, "
+                  << metrics.verifyMissed() << " missed" << std::endl;
+    }
+    
     // Cleanup
     if (stepsWriter) {
         delete stepsWriter;
     }
-    if (pairsWriter) {
-        delete pairsWriter;
+    if (trajectoryWriter) {
+        delete trajectoryWriter;
+    }
+    if (deltaWriter) {
+        delete deltaWriter;
+    }
+    if (pairLog) {
+        delete pairLog;
+    }
+    if (phasesWriter) {
+        delete phasesWriter;
+    }
+    if (broadphaseWriter) {
+        delete broadphaseWriter;
+    }
+    if (verifyWriter) {
+        delete verifyWriter;
+    }
+    
+    // Background writers are idle now, so every trace buffer is complete
+    if (!config.trace.empty()) {
+        if (checkpointWriter) {
+            checkpointWriter->wait();
+        }
+        trace::write(config.trace);
     }
     
 #ifdef WITH_SFML
@@ -420,5 +850,6 @@ int main(int argc, char* argv[]) {
     }
 #endif
     
-    return 0;
+    // A broad phase that missed contacts fails the run
+    return metrics.verifyMissed() > 0 ? 3 : 0;
 }
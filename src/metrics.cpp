@@ -1,10 +1,17 @@
 #include "metrics.hpp"
+#include "binary_io.hpp"
 #include <algorithm>
 #include <numeric>
 #include <cmath>
+#include <fstream>
+#include <sstream>
+#include <string>
 
-Metrics::Metrics() 
-    : totalSteps_(0), totalCollisions_(0), totalCandidatesChecked_(0), N_(0) {
+Metrics::Metrics(int histDigits)
+    : stepHist_(histDigits), candHist_(histDigits),
+      phaseHist_(kPhaseCount, LatencyHistogram(histDigits)),
+      driftHist_(histDigits, uint64_t(1) << 52),
+      perfMask_(0), totalSteps_(0), totalCollisions_(0), totalCandidatesChecked_(0), N_(0) {
     runStartTime_ = std::chrono::high_resolution_clock::now();
 }
 
@@ -14,52 +21,164 @@ void Metrics::begin_step() {
 
 void Metrics::end_step(uint32_t candidates) {
     auto stepEndTime = std::chrono::high_resolution_clock::now();
-    auto stepDuration = std::chrono::duration_cast<std::chrono::microseconds>(
-        stepEndTime - stepStartTime_);
-    double ms = stepDuration.count() / 1000.0;
-    
-    StepSample sample;
-    sample.ms = ms;
-    sample.candidates_checked = candidates;
-    samples_.push_back(sample);
+    auto stepNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        stepEndTime - stepStartTime_).count();
+    stepHist_.record(static_cast<uint64_t>(std::max<int64_t>(stepNs, 0)));
+    candHist_.record(candidates);
     
     totalSteps_++;
     totalCandidatesChecked_ += candidates;
+    
+    // Single writer: plain relaxed stores, no read-modify-write needed
+    double seconds = stepNs * 1e-9;
+    int bucket = 0;
+    while (bucket < LiveMetrics::kBuckets && seconds > LiveMetrics::kBucketBounds[bucket]) {
+        bucket++;
+    }
+    auto bump = [](auto& counter, uint64_t by) {
+        counter.store(counter.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    };
+    bump(live_.bucketCounts[bucket], 1);
+    bump(live_.stepNsSum, static_cast<uint64_t>(std::max<int64_t>(stepNs, 0)));
+    bump(live_.candidatesTotal, candidates);
+    bump(live_.stepsRecorded, 1);
+    live_.step.store(static_cast<uint64_t>(totalSteps_), std::memory_order_relaxed);
     runEndTime_ = stepEndTime;
 }
 
-void Metrics::record_energy(double E) {
-    energy_samples_.push_back(E);
+void Metrics::record_energy(double E, double px, double py) {
+    live_.momentumX.store(px, std::memory_order_relaxed);
+    live_.momentumY.store(py, std::memory_order_relaxed);
+    if (liveE0_ <= 0.0) return;
+    
+    double drift = (E - liveE0_) / liveE0_;
+    live_.energyDrift.store(drift, std::memory_order_relaxed);
+    driftHist_.record(static_cast<uint64_t>(std::llround(std::abs(drift) / kDriftUnit)));
+    driftMax_ = std::max(driftMax_, std::abs(drift));
+}
+
+void Metrics::record_broadphase(const BroadphaseStats& stats) {
+    BroadphaseStats& t = bpTotals_;
+    t.kind = stats.kind;
+    for (int b = 0; b < BroadphaseStats::kOccupancyBins; ++b) {
+        t.occupancy[b] += stats.occupancy[b];
+    }
+    t.buckets += stats.buckets;
+    t.bodies += stats.bodies;
+    t.maxOccupancy = std::max(t.maxOccupancy, stats.maxOccupancy);
+    t.nodes += stats.nodes;
+    t.maxDepth = std::max(t.maxDepth, stats.maxDepth);
+    t.internalBodies += stats.internalBodies;
+    t.tableSize = stats.tableSize;
+    t.probeTotal += stats.probeTotal;
+    t.maxProbe = std::max(t.maxProbe, stats.maxProbe);
+    t.resizes = stats.resizes;
+    bpSteps_++;
+}
+
+void Metrics::record_memory(const MemoryStats& mem) {
+    peak_memory.particles = std::max(peak_memory.particles, mem.particles);
+    peak_memory.broadphase = std::max(peak_memory.broadphase, mem.broadphase);
+    peak_memory.scratch = std::max(peak_memory.scratch, mem.scratch);
+    peak_memory.output = std::max(peak_memory.output, mem.output);
+    peakTrackedBytes_ = std::max(peakTrackedBytes_, mem.total());
+}
+
+void Metrics::record_engine_change(int step, const std::string& engine, const std::string& reason) {
+    engineChanges_.push_back({step, engine, reason});
+}
+
+void Metrics::record_verification(uint64_t overlapping, uint64_t missed) {
+    verifySteps_++;
+    verifyOverlapping_ += overlapping;
+    verifyMissed_ += missed;
+}
+
+namespace {
+
+// Peak resident set size in MB, from the VmHWM line (kB) of /proc/self/status
+double readPeakRssMb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stod(line.substr(6)) / 1024.0;
+        }
+    }
+    return 0.0;
+}
+
+}
+
+void Metrics::recordCollisions(int collisions) {
+    totalCollisions_ += collisions;
+    live_.collisionsLastStep.store(static_cast<uint32_t>(collisions), std::memory_order_relaxed);
+    live_.collisionsTotal.store(live_.collisionsTotal.load(std::memory_order_relaxed) + collisions,
+                                std::memory_order_relaxed);
+}
+
+void Metrics::record_phases(const PhaseTimes& times) {
+    for (int ph = 0; ph < kPhaseCount; ++ph) {
+        phaseHist_[ph].record(static_cast<uint64_t>(std::llround(std::max(times.ms[ph], 0.0) * 1e6)));
+        if (times.perf) {
+            for (int e = 0; e < kPerfEventCount; ++e) {
+                perfTotals_[ph].v[e] += times.counts[ph].v[e];
+            }
+        }
+    }
 }
 
 void Metrics::finalize(double sim_time_seconds, double E0) {
-    if (samples_.empty()) {
+    if (stepHist_.count() == 0) {
         return;
     }
     
     // Compute steps_per_sec from wall-clock time
-    auto wallDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
-        runEndTime_ - runStartTime_).count();
-    if (wallDuration > 0) {
-        steps_per_sec = (totalSteps_ * 1000.0) / wallDuration;
+    double wallSeconds = std::chrono::duration<double>(runEndTime_ - runStartTime_).count();
+    if (wallSeconds > 0.0) {
+        steps_per_sec = totalSteps_ / wallSeconds;
     }
     
-    // Compute latency percentiles
-    std::vector<double> stepTimes;
-    stepTimes.reserve(samples_.size());
-    for (const auto& sample : samples_) {
-        stepTimes.push_back(sample.ms);
+    // Latency percentiles: rank floor(p * (n-1)), read from the histogram
+    p50_ms = stepPercentileMs(0.50);
+    p95_ms = stepPercentileMs(0.95);
+    p99_ms = stepPercentileMs(0.99);
+    p999_ms = stepPercentileMs(0.999);
+    max_ms = stepHist_.max() / 1e6;
+    
+    // Per-phase percentiles
+    for (int ph = 0; ph < kPhaseCount; ++ph) {
+        const LatencyHistogram& hist = phaseHist_[ph];
+        phase_stats[ph].p50_ms = hist.valueAtPercentile(0.50) / 1e6;
+        phase_stats[ph].p95_ms = hist.valueAtPercentile(0.95) / 1e6;
+        phase_stats[ph].p99_ms = hist.valueAtPercentile(0.99) / 1e6;
+        phase_stats[ph].max_ms = hist.max() / 1e6;
     }
-    std::sort(stepTimes.begin(), stepTimes.end());
     
-    if (!stepTimes.empty()) {
-        // p50: floor(0.5 * (n-1))
-        int idx50 = static_cast<int>(std::floor(0.5 * (stepTimes.size() - 1)));
-        p50_ms = stepTimes[idx50];
-        
-        // p95: floor(0.95 * (n-1))
-        int idx95 = static_cast<int>(std::floor(0.95 * (stepTimes.size() - 1)));
-        p95_ms = stepTimes[idx95];
+    // Memory
+    if (N_ > 0) {
+        bytes_per_particle = static_cast<double>(peakTrackedBytes_) / N_;
+    }
+    peak_rss_mb = readPeakRssMb();
+    
+    // Hardware counter ratios per phase
+    auto has = [this](PerfEvent e) { return (perfMask_ >> static_cast<int>(e)) & 1u; };
+    double particleSteps = static_cast<double>(N_) * totalSteps_;
+    for (int ph = 0; ph < kPhaseCount; ++ph) {
+        const PerfCounts& c = perfTotals_[ph];
+        PhasePerfStats& out = phase_perf[ph];
+        if (has(PerfEvent::Cycles) && has(PerfEvent::Instructions) && c[PerfEvent::Cycles] > 0) {
+            out.ipc = static_cast<double>(c[PerfEvent::Instructions]) / c[PerfEvent::Cycles];
+        }
+        if (has(PerfEvent::L1DMisses) && particleSteps > 0) {
+            out.l1_miss_per_particle = c[PerfEvent::L1DMisses] / particleSteps;
+        }
+        if (has(PerfEvent::LLCMisses) && particleSteps > 0) {
+            out.llc_miss_per_particle = c[PerfEvent::LLCMisses] / particleSteps;
+        }
+        if (has(PerfEvent::Branches) && has(PerfEvent::BranchMisses) && c[PerfEvent::Branches] > 0) {
+            out.branch_miss_rate = static_cast<double>(c[PerfEvent::BranchMisses]) / c[PerfEvent::Branches];
+        }
     }
     
     // Compute cand_per_particle = total candidates / (N * steps)
@@ -68,23 +187,86 @@ void Metrics::finalize(double sim_time_seconds, double E0) {
         cand_per_particle = static_cast<double>(totalCandidatesChecked_) / (N_ * totalSteps_);
     }
     
-    // Compute energy drift if energy samples available
-    if (!energy_samples_.empty() && E0 > 0.0) {
-        energy_drift_samples_.clear();
-        for (double E : energy_samples_) {
-            double drift = (E - E0) / E0;
-            energy_drift_samples_.push_back(std::abs(drift));
-        }
-        
-        std::sort(energy_drift_samples_.begin(), energy_drift_samples_.end());
-        
-        if (!energy_drift_samples_.empty()) {
-            // Median
-            int idx_median = energy_drift_samples_.size() / 2;
-            energy_drift_median = energy_drift_samples_[idx_median];
-            
-            // Max
-            energy_drift_max = energy_drift_samples_.back();
-        }
+    // Energy drift, relative to E0 (set_initial_energy)
+    if (driftHist_.count() > 0 && E0 > 0.0) {
+        energy_drift_median = driftHist_.valueAtPercentile(0.5) * kDriftUnit;
+        energy_drift_max = driftMax_;
     }
-}
\ No newline at end of file
+}
+
+using binary_io::put;
+using binary_io::get;
+using binary_io::putString;
+using binary_io::getString;
+
+std::string Metrics::save() const {
+    std::ostringstream os(std::ios::binary);
+    int64_t elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        runEndTime_ - runStartTime_).count();
+    put(os, totalSteps_);
+    put(os, totalCollisions_);
+    put(os, totalCandidatesChecked_);
+    put(os, elapsedNs);
+    putString(os, stepHist_.save());
+    putString(os, candHist_.save());
+    for (const auto& hist : phaseHist_) {
+        putString(os, hist.save());
+    }
+    putString(os, driftHist_.save());
+    put(os, driftMax_);
+    for (const auto& counts : perfTotals_) {
+        put(os, counts);
+    }
+    put(os, bpTotals_);
+    put(os, bpSteps_);
+    put(os, peak_memory);
+    put(os, peakTrackedBytes_);
+    put(os, static_cast<uint64_t>(engineChanges_.size()));
+    for (const auto& change : engineChanges_) {
+        put(os, change.step);
+        putString(os, change.engine);
+        putString(os, change.reason);
+    }
+    put(os, verifySteps_);
+    put(os, verifyOverlapping_);
+    put(os, verifyMissed_);
+    return os.str();
+}
+
+bool Metrics::load(const std::string& state) {
+    std::istringstream is(state, std::ios::binary);
+    int64_t elapsedNs = 0;
+    std::string hist;
+    bool ok = get(is, totalSteps_) &&
+              get(is, totalCollisions_) &&
+              get(is, totalCandidatesChecked_) &&
+              get(is, elapsedNs) &&
+              getString(is, hist) && stepHist_.load(hist) &&
+              getString(is, hist) && candHist_.load(hist);
+    for (auto& phase : phaseHist_) {
+        ok = ok && getString(is, hist) && phase.load(hist);
+    }
+    ok = ok && getString(is, hist) && driftHist_.load(hist) && get(is, driftMax_);
+    for (auto& counts : perfTotals_) {
+        ok = ok && get(is, counts);
+    }
+    ok = ok && get(is, bpTotals_) && get(is, bpSteps_) &&
+         get(is, peak_memory) && get(is, peakTrackedBytes_);
+    uint64_t changes = 0;
+    ok = ok && get(is, changes);
+    engineChanges_.clear();
+    for (uint64_t i = 0; ok && i < changes; ++i) {
+        EngineChange change;
+        ok = get(is, change.step) && getString(is, change.engine) && getString(is, change.reason);
+        engineChanges_.push_back(change);
+    }
+    ok = ok && get(is, verifySteps_) && get(is, verifyOverlapping_) && get(is, verifyMissed_);
+    if (!ok) return false;
+    
+    live_.step.store(static_cast<uint64_t>(totalSteps_), std::memory_order_relaxed);
+    
+    // Wall-clock rate continues from the time already spent before the restart
+    runEndTime_ = std::chrono::high_resolution_clock::now();
+    runStartTime_ = runEndTime_ - std::chrono::nanoseconds(elapsedNs);
+    return true;
+}
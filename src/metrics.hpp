@@ -1,20 +1,80 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
 #include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <string>
+#include "phase_timer.hpp"
+#include "histogram.hpp"
+#include "broadphase_stats.hpp"
 
-struct StepSample {
-    double ms;
-    uint32_t candidates_checked;
+struct PhaseStats {
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+// Heap bytes held by the simulation, sampled periodically
+struct MemoryStats {
+    uint64_t particles = 0;       // Particle array
+    uint64_t broadphase = 0;      // Quadtree nodes and body vectors / hash table and cells
+    uint64_t scratch = 0;         // Narrow-phase scratch buffers
+    uint64_t output = 0;          // Writer and pair-log buffers
+    
+    uint64_t total() const { return particles + broadphase + scratch + output; }
+};
+
+// Derived from --perf_counters; NaN where the event was not available
+struct PhasePerfStats {
+    double ipc = std::nan("");
+    double l1_miss_per_particle = std::nan("");   // Per particle per step
+    double llc_miss_per_particle = std::nan("");
+    double branch_miss_rate = std::nan("");       // Misses / branches
+};
+
+// Running values readable from other threads (--metrics_port). The step loop
+// is the only writer and uses relaxed stores, so it never blocks; readers
+// may see values from adjacent steps mixed together.
+struct LiveMetrics {
+    static constexpr int kBuckets = 13;
+    static constexpr double kBucketBounds[kBuckets] = {  // Step duration upper bounds, seconds
+        0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0};
+    
+    std::atomic<uint64_t> step{0};              // Steps completed, including before a restart
+    std::atomic<uint64_t> stepsRecorded{0};     // Steps timed by this process
+    std::atomic<uint64_t> candidatesTotal{0};
+    std::atomic<uint64_t> collisionsTotal{0};
+    std::atomic<uint32_t> collisionsLastStep{0};
+    std::atomic<uint64_t> stepNsSum{0};
+    std::atomic<uint64_t> bucketCounts[kBuckets + 1] = {};  // Non-cumulative; last is +Inf
+    std::atomic<double> energyDrift{0.0};       // (E - E0) / E0 at the last energy sample
+    std::atomic<double> momentumX{0.0};
+    std::atomic<double> momentumY{0.0};
+};
+
+// Engine rebuilt mid-run (re-tuned parameters or a different method)
+struct EngineChange {
+    int step;                 // First step run by the new engine
+    std::string engine;       // Method and parameters, e.g. "quadtree cap=16 max_depth=10"
+    std::string reason;
 };
 
 struct Metrics {
-    Metrics();
+    explicit Metrics(int histDigits = 3);  // Significant digits kept by the latency histograms
     
     void begin_step();                    // Start timer for current step
     void end_step(uint32_t candidates);  // Stop timer, record candidates checked this step
-    void record_energy(double E);        // Optional energy log (per simulated second)
+    void record_energy(double E, double px = 0.0, double py = 0.0);  // Energy and momentum, every step
+    void set_initial_energy(double E0) { liveE0_ = E0; }  // Reference for the drift; set before record_energy
+    void record_phases(const PhaseTimes& times);  // Engine phase breakdown of the last step
+    void record_broadphase(const BroadphaseStats& stats);  // --broadphase_stats, once per step
+    void record_memory(const MemoryStats& mem);  // Keeps the peak of each part
+    void record_engine_change(int step, const std::string& engine, const std::string& reason);
+    void record_verification(uint64_t overlapping, uint64_t missed);  // --verify_broadphase, per checked step
+    void enablePerfCounters(uint32_t eventMask) { perfMask_ = eventMask; }  // PerfCounters::eventMask()
     
     void finalize(double sim_time_seconds, double E0);  // Compute percentiles, averages, drift
     
@@ -22,19 +82,65 @@ struct Metrics {
     double steps_per_sec = 0.0;
     double p50_ms = 0.0;
     double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double p999_ms = 0.0;
+    double max_ms = 0.0;
     double cand_per_particle = 0.0;
     double energy_drift_median = 0.0;
     double energy_drift_max = 0.0;
+    PhaseStats phase_stats[kPhaseCount];  // Indexed by Phase
+    PhasePerfStats phase_perf[kPhaseCount];
+    MemoryStats peak_memory;               // Per-part peaks
+    double bytes_per_particle = 0.0;       // Peak tracked bytes / N
+    double peak_rss_mb = 0.0;              // VmHWM from /proc/self/status (0 if unavailable)
+    
+    // Live views, valid at any point of the run (latencies in nanoseconds)
+    const LatencyHistogram& stepLatency() const { return stepHist_; }
+    const LatencyHistogram& candidateCounts() const { return candHist_; }
+    const LatencyHistogram& phaseLatency(Phase phase) const { return phaseHist_[static_cast<int>(phase)]; }
+    double stepPercentileMs(double p) const { return stepHist_.valueAtPercentile(p) / 1e6; }
+    
+    const LiveMetrics& live() const { return live_; }
+    
+    // Broad-phase structure over the run: counts and histogram summed over
+    // steps, max* fields are maxima, tableSize/resizes are from the last step
+    const BroadphaseStats& broadphaseTotals() const { return bpTotals_; }
+    uint64_t broadphaseSteps() const { return bpSteps_; }
+    
+    const std::vector<EngineChange>& engineChanges() const { return engineChanges_; }
+    
+    // --verify_broadphase totals: steps checked, overlapping pairs, pairs missed
+    uint64_t verifySteps() const { return verifySteps_; }
+    uint64_t verifyOverlapping() const { return verifyOverlapping_; }
+    uint64_t verifyMissed() const { return verifyMissed_; }
     
     // Accessors for compatibility
     int getTotalCollisions() const { return totalCollisions_; }
-    void recordCollisions(int collisions) { totalCollisions_ += collisions; }
+    void recordCollisions(int collisions);
     void setN(int N) { N_ = N; }
     
+    // Accumulated samples and counters, for checkpoint/restart
+    std::string save() const;
+    bool load(const std::string& state);
+    
 private:
-    std::vector<StepSample> samples_;
-    std::vector<double> energy_samples_;
-    std::vector<double> energy_drift_samples_;
+    LatencyHistogram stepHist_;
+    LatencyHistogram candHist_;
+    std::vector<LatencyHistogram> phaseHist_;  // Indexed by Phase
+    LatencyHistogram driftHist_;                 // |E - E0| / E0 in units of kDriftUnit
+    double driftMax_ = 0.0;
+    static constexpr double kDriftUnit = 1e-12;
+    uint32_t perfMask_;
+    LiveMetrics live_;
+    BroadphaseStats bpTotals_;
+    uint64_t bpSteps_ = 0;
+    uint64_t peakTrackedBytes_ = 0;
+    std::vector<EngineChange> engineChanges_;
+    uint64_t verifySteps_ = 0;
+    uint64_t verifyOverlapping_ = 0;
+    uint64_t verifyMissed_ = 0;
+    double liveE0_ = 0.0;
+    PerfCounts perfTotals_[kPhaseCount];
     
     int totalSteps_;
     int totalCollisions_;
@@ -44,6 +150,4 @@ private:
     std::chrono::high_resolution_clock::time_point stepStartTime_;
     std::chrono::high_resolution_clock::time_point runStartTime_;
     std::chrono::high_resolution_clock::time_point runEndTime_;
-    
-    double percentile(const std::vector<double>& sorted, double p) const;
 };
\ No newline at end of file
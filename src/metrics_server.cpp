@@ -0,0 +1,198 @@
+#include "metrics_server.hpp"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+double nowSeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void sendAll(int fd, const std::string& data) {
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = ::send(fd, p, left, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        p += n;
+        left -= static_cast<size_t>(n);
+    }
+}
+
+}
+
+MetricsServer::MetricsServer(int port, const Metrics& metrics, const std::string& method, int N)
+    : metrics_(metrics), method_(method), labels_("{method=\"" + method + "\"}"), N_(N),
+      listenFd_(-1), stop_(false), windowCount_(0), windowHead_(0) {
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd_ < 0) {
+        std::cerr << "Warning: Could not create metrics socket: " << std::strerror(errno) << std::endl;
+        return;
+    }
+    int yes = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd_, 8) != 0) {
+        std::cerr << "Warning: Could not listen on 127.0.0.1:" << port << ": "
+                  << std::strerror(errno) << std::endl;
+        ::close(listenFd_);
+        listenFd_ = -1;
+        return;
+    }
+
+    thread_ = std::thread(&MetricsServer::serve, this);
+}
+
+MetricsServer::~MetricsServer() {
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (listenFd_ >= 0) {
+        ::close(listenFd_);
+    }
+}
+
+void MetricsServer::serve() {
+    double nextSample = 0.0;
+    while (!stop_) {
+        double now = nowSeconds();
+        if (now >= nextSample) {
+            sample();
+            nextSample = now + 0.25;
+        }
+
+        pollfd pfd = {listenFd_, POLLIN, 0};
+        int timeoutMs = static_cast<int>((nextSample - now) * 1000.0) + 1;
+        if (::poll(&pfd, 1, timeoutMs) <= 0 || !(pfd.revents & POLLIN)) {
+            continue;
+        }
+        int fd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            respond(fd);
+            ::close(fd);
+        }
+    }
+}
+
+void MetricsServer::sample() {
+    windowTime_[windowHead_] = nowSeconds();
+    windowSteps_[windowHead_] = metrics_.live().stepsRecorded.load(std::memory_order_relaxed);
+    windowHead_ = (windowHead_ + 1) % kWindowSamples;
+    if (windowCount_ < kWindowSamples) windowCount_++;
+}
+
+void MetricsServer::respond(int fd) {
+    // Read the request head; only the request line matters
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        pollfd pfd = {fd, POLLIN, 0};
+        if (::poll(&pfd, 1, 1000) <= 0) return;
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) return;
+        request.append(buf, static_cast<size_t>(n));
+    }
+
+    std::string status = "200 OK";
+    std::string body;
+    if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0) {
+        body = render();
+    } else {
+        status = "404 Not Found";
+        body = "Try /metrics\n";
+    }
+
+    std::ostringstream response;
+    response << "HTTP/1.1 " << status << "\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << body.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << body;
+    sendAll(fd, response.str());
+}
+
+std::string MetricsServer::render() const {
+    const LiveMetrics& live = metrics_.live();
+    uint64_t step = live.step.load(std::memory_order_relaxed);
+    uint64_t recorded = live.stepsRecorded.load(std::memory_order_relaxed);
+    uint64_t candidates = live.candidatesTotal.load(std::memory_order_relaxed);
+
+    // Rate between the oldest and newest samples of the window
+    double rate = 0.0;
+    if (windowCount_ >= 2) {
+        int newest = (windowHead_ + kWindowSamples - 1) % kWindowSamples;
+        int oldest = (windowHead_ + kWindowSamples - windowCount_) % kWindowSamples;
+        double span = windowTime_[newest] - windowTime_[oldest];
+        if (span > 0.0) {
+            rate = (windowSteps_[newest] - windowSteps_[oldest]) / span;
+        }
+    }
+
+    std::ostringstream os;
+    os << "# HELP particlebox_step Steps completed by the simulation\n"
+       << "# TYPE particlebox_step gauge\n"
+       << "particlebox_step" << labels_ << " " << step << "\n"
+       << "# HELP particlebox_steps_per_second Step rate over the last 10 seconds\n"
+       << "# TYPE particlebox_steps_per_second gauge\n"
+       << "particlebox_steps_per_second" << labels_ << " " << rate << "\n";
+
+    os << "# HELP particlebox_step_duration_seconds Wall time of one simulation step\n"
+       << "# TYPE particlebox_step_duration_seconds histogram\n";
+    uint64_t cumulative = 0;
+    for (int b = 0; b <= LiveMetrics::kBuckets; ++b) {
+        cumulative += live.bucketCounts[b].load(std::memory_order_relaxed);
+        os << "particlebox_step_duration_seconds_bucket{method=\"" << method_ << "\",le=\"";
+        if (b < LiveMetrics::kBuckets) {
+            os << LiveMetrics::kBucketBounds[b];
+        } else {
+            os << "+Inf";
+        }
+        os << "\"} " << cumulative << "\n";
+    }
+    os << "particlebox_step_duration_seconds_sum" << labels_ << " "
+       << live.stepNsSum.load(std::memory_order_relaxed) * 1e-9 << "\n"
+       << "particlebox_step_duration_seconds_count" << labels_ << " " << cumulative << "\n";
+
+    double candPerParticle = (recorded > 0 && N_ > 0)
+        ? static_cast<double>(candidates) / (static_cast<double>(N_) * recorded) : 0.0;
+    os << "# HELP particlebox_candidates_per_particle Candidate pairs checked per particle per step\n"
+       << "# TYPE particlebox_candidates_per_particle gauge\n"
+       << "particlebox_candidates_per_particle" << labels_ << " " << candPerParticle << "\n"
+       << "# HELP particlebox_collisions_per_step Collisions resolved in the last step\n"
+       << "# TYPE particlebox_collisions_per_step gauge\n"
+       << "particlebox_collisions_per_step" << labels_ << " "
+       << live.collisionsLastStep.load(std::memory_order_relaxed) << "\n"
+       << "# HELP particlebox_collisions_total Collisions resolved by this process\n"
+       << "# TYPE particlebox_collisions_total counter\n"
+       << "particlebox_collisions_total" << labels_ << " "
+       << live.collisionsTotal.load(std::memory_order_relaxed) << "\n"
+       << "# HELP particlebox_energy_drift Relative energy drift (E - E0) / E0 at the last sample\n"
+       << "# TYPE particlebox_energy_drift gauge\n"
+       << "particlebox_energy_drift" << labels_ << " "
+       << live.energyDrift.load(std::memory_order_relaxed) << "\n"
+       << "# HELP particlebox_momentum Total momentum (unit mass) after the last step\n"
+       << "# TYPE particlebox_momentum gauge\n"
+       << "particlebox_momentum{method=\"" << method_ << "\",axis=\"x\"} "
+       << live.momentumX.load(std::memory_order_relaxed) << "\n"
+       << "particlebox_momentum{method=\"" << method_ << "\",axis=\"y\"} "
+       << live.momentumY.load(std::memory_order_relaxed) << "\n";
+    return os.str();
+}
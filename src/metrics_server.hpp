@@ -0,0 +1,47 @@
+#pragma once
+
+#include "metrics.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+// Prometheus text exposition of a running simulation (--metrics_port)
+//
+// A background thread accepts HTTP/1.0-1.1 GET requests on 127.0.0.1:<port>
+// and answers /metrics from Metrics::live(), which the step loop updates with
+// relaxed atomic stores only. Between requests the thread samples the step
+// counter every 250 ms to report steps/sec over a sliding window.
+
+class MetricsServer {
+public:
+    MetricsServer(int port, const Metrics& metrics, const std::string& method, int N);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    bool isOpen() const { return listenFd_ >= 0; }
+
+private:
+    static constexpr int kWindowSamples = 40;  // 10 s at one sample per 250 ms
+
+    const Metrics& metrics_;
+    std::string method_;
+    std::string labels_;                       // {method="..."}
+    int N_;
+    int listenFd_;
+    std::atomic<bool> stop_;
+    std::thread thread_;
+
+    // Sliding window of (time, steps) samples, touched only by the server thread
+    double windowTime_[kWindowSamples];
+    uint64_t windowSteps_[kWindowSamples];
+    int windowCount_;
+    int windowHead_;
+
+    void serve();
+    void sample();
+    void respond(int fd);
+    std::string render() const;
+};
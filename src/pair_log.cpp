@@ -0,0 +1,198 @@
+#include "pair_log.hpp"
+#include "csv.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+PairLog::PairLog(const std::string& filename, int N, uint64_t seed, double sampleRate, bool append)
+    : fd_(-1), step_(0), sampleThreshold_(UINT64_MAX), queuedRecords_(0), writing_(false), stop_(false) {
+    sampleRate = std::clamp(sampleRate, 0.0, 1.0);
+    if (sampleRate < 1.0) {
+        sampleThreshold_ = static_cast<uint64_t>(std::ldexp(sampleRate, 64));
+    }
+
+    int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+    fd_ = ::open(filename.c_str(), flags, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Warning: Could not open pair log: " << filename << std::endl;
+        return;
+    }
+
+    if (!append) {
+        PairLogHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "PBPAIR1", 8);
+        header.version = 1;
+        header.record_bytes = sizeof(PairRecord);
+        header.N = static_cast<uint64_t>(N);
+        header.seed = seed;
+        header.sample_rate = sampleRate;
+        writeAll(&header, sizeof(header));
+    }
+
+    writer_ = std::thread(&PairLog::writerLoop, this);
+}
+
+PairLog::~PairLog() {
+    if (writer_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        ready_.notify_one();
+        writer_.join();
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void PairLog::beginStep(int step) {
+    step_ = static_cast<uint32_t>(step);
+    current_.clear();
+}
+
+void PairLog::endStep() {
+    if (fd_ < 0 || current_.empty()) return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    // Wait for the writer rather than queue without bound; a step larger than
+    // the cap still goes through once the queue is empty
+    if (!queue_.empty() && queuedRecords_ + current_.size() > kMaxQueuedRecords) {
+        trace::Scope scope("pair_log_wait", "io");
+        space_.wait(lock, [this] {
+            return queue_.empty() || queuedRecords_ + current_.size() <= kMaxQueuedRecords;
+        });
+    }
+    queuedRecords_ += current_.size();
+    queue_.push_back({step_, std::move(current_)});
+    if (!spare_.empty()) {
+        current_ = std::move(spare_.back());
+        spare_.pop_back();
+    }
+    current_.clear();
+    ready_.notify_one();
+}
+
+void PairLog::writerLoop() {
+    trace::setThreadName("pair-log");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ready_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+        if (queue_.empty()) {
+            break;  // stop_ and nothing left to write
+        }
+
+        Block block = std::move(queue_.front());
+        queue_.pop_front();
+        queuedRecords_ -= block.records.size();
+        writing_ = true;
+        lock.unlock();
+        space_.notify_one();
+
+        {
+            trace::Scope scope("write_pairs", "io");
+            uint32_t head[2] = {block.step, static_cast<uint32_t>(block.records.size())};
+            writeAll(head, sizeof(head));
+            writeAll(block.records.data(), block.records.size() * sizeof(PairRecord));
+        }
+
+        lock.lock();
+        writing_ = false;
+        block.records.clear();
+        spare_.push_back(std::move(block.records));
+        if (queue_.empty()) {
+            drained_.notify_all();
+        }
+    }
+}
+
+void PairLog::writeAll(const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n > 0) {
+        ssize_t written = ::write(fd_, p, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Warning: Pair log write failed: " << std::strerror(errno) << std::endl;
+            return;
+        }
+        p += written;
+        n -= static_cast<size_t>(written);
+    }
+}
+
+void PairLog::flush() {
+    if (fd_ < 0) return;
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this] { return queue_.empty() && !writing_; });
+}
+
+size_t PairLog::memoryBytes() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t records = current_.capacity();
+    for (const auto& block : queue_) {
+        records += block.records.capacity();
+    }
+    for (const auto& buffer : spare_) {
+        records += buffer.capacity();
+    }
+    return records * sizeof(PairRecord);
+}
+
+std::string PairLog::saveState() {
+    flush();
+    uint64_t length = 0;
+    if (fd_ >= 0) {
+        off_t end = ::lseek(fd_, 0, SEEK_END);
+        length = end > 0 ? static_cast<uint64_t>(end) : 0;
+    }
+    return std::string(reinterpret_cast<const char*>(&length), sizeof(length));
+}
+
+bool PairLog::restoreState(const std::string& state) {
+    if (fd_ < 0 || state.size() != sizeof(uint64_t)) return false;
+    flush();
+    uint64_t length;
+    std::memcpy(&length, state.data(), sizeof(length));
+    return ::ftruncate(fd_, static_cast<off_t>(length)) == 0;
+}
+
+bool PairLog::exportCSV(const std::string& binFile, const std::string& csvFile) {
+    std::ifstream in(binFile, std::ios::binary);
+    PairLogHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, "PBPAIR1", 8) != 0 || header.record_bytes != sizeof(PairRecord)) {
+        std::cerr << "Error: Not a particle-box pair log: " << binFile << std::endl;
+        return false;
+    }
+
+    CSVWriter out(csvFile);
+    if (!out.isOpen()) return false;
+    out.writeRow({"step", "i", "j", "tested", "collided"});
+
+    std::vector<PairRecord> records;
+    uint32_t head[2];
+    while (in.read(reinterpret_cast<char*>(head), sizeof(head))) {
+        records.resize(head[1]);
+        if (!in.read(reinterpret_cast<char*>(records.data()), records.size() * sizeof(PairRecord))) {
+            std::cerr << "Warning: Pair log ends in a partial block: " << binFile << std::endl;
+            break;
+        }
+        for (const auto& r : records) {
+            out.field(static_cast<int64_t>(head[0]))
+               .field(static_cast<int64_t>(r.i))
+               .field(static_cast<int64_t>(r.j & PairRecord::ID_MASK))
+               .field((r.j & PairRecord::TESTED) ? 1 : 0)
+               .field((r.j & PairRecord::COLLIDED) ? 1 : 0);
+            out.endRow();
+        }
+    }
+    return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Broad-phase candidate log (pairs.bin)
+//
+// Layout (little-endian):
+//   [PairLogHeader]                                 fixed 64 bytes
+//   per step with at least one record:
+//     uint32 step, uint32 count, count x PairRecord
+//
+// Engines call record() for every candidate their broad phase returns; the
+// records of one step are collected in memory and handed to a background
+// thread at endStep(), so the step loop only waits on the disk when more than
+// kMaxQueuedRecords (256 MB) are still queued, which keeps memory bounded when
+// the writer falls behind. With a sample rate below 1, a pair is kept when a
+// hash of (step, i, j) falls under the rate, so the same pairs are sampled on
+// every run.
+
+struct PairLogHeader {
+    char magic[8];           // "PBPAIR1\0"
+    uint32_t version;
+    uint32_t record_bytes;
+    uint64_t N;
+    uint64_t seed;
+    double sample_rate;
+    char reserved[24];
+};
+
+static_assert(sizeof(PairLogHeader) == 64, "PairLogHeader must stay 64 bytes");
+
+struct PairRecord {
+    uint32_t i;
+    uint32_t j;              // Bits 0-29: id, bit 30: collided, bit 31: tested
+
+    static constexpr uint32_t TESTED = 1u << 31;
+    static constexpr uint32_t COLLIDED = 1u << 30;
+    static constexpr uint32_t ID_MASK = COLLIDED - 1;
+};
+
+class PairLog {
+public:
+    PairLog(const std::string& filename, int N, uint64_t seed, double sampleRate = 1.0,
+            bool append = false);
+    ~PairLog();
+
+    PairLog(const PairLog&) = delete;
+    PairLog& operator=(const PairLog&) = delete;
+
+    void beginStep(int step);
+    void endStep();
+
+    // Called from the engines' narrow phase
+    void record(int i, int j, bool tested, bool collided) {
+        if (sampleThreshold_ != UINT64_MAX && sampleHash(i, j) > sampleThreshold_) return;
+        uint32_t flags = (tested ? PairRecord::TESTED : 0u) | (collided ? PairRecord::COLLIDED : 0u);
+        current_.push_back({static_cast<uint32_t>(i), (static_cast<uint32_t>(j) & PairRecord::ID_MASK) | flags});
+    }
+
+    void flush();             // Blocks until every finished step is on disk
+    bool isOpen() const { return fd_ >= 0; }
+    size_t memoryBytes();     // Current, queued and recycled record buffers
+
+    // Checkpoint support (see CSVWriter)
+    std::string saveState();
+    bool restoreState(const std::string& state);
+
+    // Offline conversion of a pairs.bin to CSV (step,i,j,tested,collided)
+    static bool exportCSV(const std::string& binFile, const std::string& csvFile);
+
+private:
+    static constexpr size_t kMaxQueuedRecords = (size_t(256) << 20) / sizeof(PairRecord);
+
+    struct Block {
+        uint32_t step;
+        std::vector<PairRecord> records;
+    };
+
+    int fd_;
+    uint32_t step_;
+    uint64_t sampleThreshold_;
+    std::vector<PairRecord> current_;
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable drained_;
+    std::condition_variable space_;               // A block was taken off the queue
+    std::deque<Block> queue_;
+    size_t queuedRecords_;
+    std::vector<std::vector<PairRecord>> spare_;  // Recycled buffers
+    bool writing_;
+    bool stop_;
+    std::thread writer_;
+
+    uint64_t sampleHash(int i, int j) const {
+        uint64_t x = (static_cast<uint64_t>(step_) << 42) ^
+                     (static_cast<uint64_t>(static_cast<uint32_t>(i)) << 21) ^
+                     static_cast<uint32_t>(j);
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    void writerLoop();
+    void writeAll(const void* data, size_t n);
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Worker count for a --threads style setting (0 = one per core)
+inline int resolveThreads(int threads) {
+    return threads > 0 ? threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// Runs fn(0 .. count-1) on up to `threads` threads (0 = one per core), the
+// calling thread included. Items are handed out first come first served, so
+// fn must not depend on which thread runs it or in what order.
+template <typename Fn>
+void parallelFor(int count, int threads, Fn fn) {
+    threads = std::min(resolveThreads(threads), count);
+    if (threads <= 1) {
+        for (int i = 0; i < count; ++i) fn(i);
+        return;
+    }
+    std::atomic<int> next{0};
+    auto worker = [&]() {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) fn(i);
+    };
+    std::vector<std::thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool) t.join();
+}
@@ -0,0 +1,133 @@
+#include "perf_counters.hpp"
+#include <iostream>
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+PerfCounters::PerfCounters() {
+    for (int& fd : fds_) fd = -1;
+}
+
+#ifdef __linux__
+
+namespace {
+
+struct EventSpec {
+    uint32_t type;
+    uint64_t config;
+};
+
+EventSpec eventSpec(PerfEvent e) {
+    auto cache = [](uint64_t id, uint64_t op, uint64_t result) {
+        return id | (op << 8) | (result << 16);
+    };
+    switch (e) {
+        case PerfEvent::Cycles:       return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+        case PerfEvent::Instructions: return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+        case PerfEvent::Branches:     return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS};
+        case PerfEvent::BranchMisses: return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+        case PerfEvent::L1DMisses:
+            return {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                                              PERF_COUNT_HW_CACHE_RESULT_MISS)};
+        case PerfEvent::LLCMisses:    return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+        default:                      return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+    }
+}
+
+int openEvent(const EventSpec& spec, int groupFd) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    attr.disabled = groupFd < 0 ? 1 : 0;  // The leader starts the whole group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+}
+
+PerfCounters::~PerfCounters() {
+    for (int fd : fds_) {
+        if (fd >= 0) ::close(fd);
+    }
+}
+
+bool PerfCounters::open() {
+    if (isOpen()) return true;
+
+    int firstErrno = 0;
+    for (int e = 0; e < kPerfEventCount; ++e) {
+        int fd = openEvent(eventSpec(static_cast<PerfEvent>(e)), leader_);
+        if (fd < 0) {
+            if (firstErrno == 0) firstErrno = errno;
+            continue;
+        }
+        if (ioctl(fd, PERF_EVENT_IOC_ID, &ids_[e]) != 0) {
+            ::close(fd);
+            continue;
+        }
+        fds_[e] = fd;
+        mask_ |= 1u << e;
+        if (leader_ < 0) leader_ = fd;
+    }
+
+    if (leader_ < 0) {
+        std::cerr << "Warning: Hardware performance counters unavailable ("
+                  << std::strerror(firstErrno) << "); continuing without --perf_counters" << std::endl;
+        return false;
+    }
+    ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void PerfCounters::read(PerfCounts& out) const {
+    out.clear();
+    if (leader_ < 0) return;
+
+    // nr, time_enabled, time_running, then {value, id} per event
+    uint64_t buf[3 + 2 * kPerfEventCount];
+    if (::read(leader_, buf, sizeof(buf)) <= 0) return;
+
+    uint64_t nr = buf[0];
+    uint64_t enabled = buf[1];
+    uint64_t running = buf[2];
+    for (uint64_t k = 0; k < nr && k < static_cast<uint64_t>(kPerfEventCount); ++k) {
+        uint64_t value = buf[3 + 2 * k];
+        uint64_t id = buf[4 + 2 * k];
+        if (running > 0 && running < enabled) {
+            value = static_cast<uint64_t>(static_cast<double>(value) * enabled / running);
+        }
+        for (int e = 0; e < kPerfEventCount; ++e) {
+            if (fds_[e] >= 0 && ids_[e] == id) {
+                out.v[e] = value;
+                break;
+            }
+        }
+    }
+}
+
+#else
+
+PerfCounters::~PerfCounters() = default;
+
+bool PerfCounters::open() {
+    std::cerr << "Warning: --perf_counters needs Linux perf_event_open; continuing without it" << std::endl;
+    return false;
+}
+
+void PerfCounters::read(PerfCounts& out) const {
+    out.clear();
+}
+
+#endif
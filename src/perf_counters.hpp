@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+// Hardware performance counters around engine phases (--perf_counters)
+//
+// Linux only: one perf_event_open group (user-space only, calling thread)
+// holding the events below, read with a single read(2) at the start and end
+// of every ScopedPhase. Events the CPU or kernel does not offer are left out
+// of the group; if none can be opened (other OS, perf_event_paranoid, VMs
+// without a virtual PMU) open() prints a warning and returns false and the
+// run continues without counters. When the kernel multiplexes the group the
+// values are scaled by time_enabled / time_running.
+
+enum class PerfEvent {
+    Cycles,
+    Instructions,
+    Branches,
+    BranchMisses,
+    L1DMisses,       // L1 data cache read misses
+    LLCMisses,       // Last-level cache misses
+    Count
+};
+
+constexpr int kPerfEventCount = static_cast<int>(PerfEvent::Count);
+
+struct PerfCounts {
+    uint64_t v[kPerfEventCount] = {};
+
+    void clear() {
+        for (uint64_t& x : v) x = 0;
+    }
+    uint64_t operator[](PerfEvent e) const { return v[static_cast<int>(e)]; }
+};
+
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool open();
+    bool isOpen() const { return leader_ >= 0; }
+    bool has(PerfEvent e) const { return (mask_ >> static_cast<int>(e)) & 1u; }
+    uint32_t eventMask() const { return mask_; }
+
+    // Current running totals of every open event (zero for the others)
+    void read(PerfCounts& out) const;
+
+private:
+    int leader_ = -1;
+    int fds_[kPerfEventCount];
+    uint64_t ids_[kPerfEventCount] = {};
+    uint32_t mask_ = 0;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "perf_counters.hpp"
+#include "trace.hpp"
+#include <chrono>
+
+// Engine step phases timed separately (see Engine::getPhaseTimes)
+enum class Phase {
+    Integrate,   // collision flag reset + position update
+    Walls,       // physics::handle_walls
+    Build,       // broad-phase rebuild
+    Narrow,      // candidate queries, overlap tests and resolution
+    Count
+};
+
+constexpr int kPhaseCount = static_cast<int>(Phase::Count);
+
+inline const char* phaseName(Phase phase) {
+    static const char* names[kPhaseCount] = {"integrate", "walls", "build", "narrow"};
+    return names[static_cast<int>(phase)];
+}
+
+struct PhaseTimes {
+    double ms[kPhaseCount] = {};
+    PerfCounts counts[kPhaseCount];       // Filled only when perf is set
+    PerfCounters* perf = nullptr;         // --perf_counters; survives clear()
+    
+    void clear() {
+        for (double& t : ms) t = 0.0;
+        if (perf) {
+            for (PerfCounts& c : counts) c.clear();
+        }
+    }
+    double& operator[](Phase phase) { return ms[static_cast<int>(phase)]; }
+    double operator[](Phase phase) const { return ms[static_cast<int>(phase)]; }
+};
+
+// Adds the lifetime of the scope to one phase. Two steady_clock reads per
+// phase, so well under 1% of any step that has work to time. With counters
+// attached, one group read(2) more on each side, outside the timed window.
+// Also emits the phase as a span when --trace is recording.
+class ScopedPhase {
+public:
+    ScopedPhase(PhaseTimes& times, Phase phase)
+        : times_(times), phase_(phase), traced_(trace::active()) {
+        if (times_.perf) times_.perf->read(startCounts_);
+        start_ = std::chrono::steady_clock::now();
+    }
+    
+    ~ScopedPhase() {
+        auto end = std::chrono::steady_clock::now();
+        times_[phase_] += std::chrono::duration<double, std::milli>(end - start_).count();
+        if (traced_) {
+            trace::record(phaseName(phase_), "phase", toNs(start_), toNs(end));
+        }
+        if (times_.perf) {
+            PerfCounts endCounts;
+            times_.perf->read(endCounts);
+            PerfCounts& acc = times_.counts[static_cast<int>(phase_)];
+            for (int e = 0; e < kPerfEventCount; ++e) {
+                // Scaled (multiplexed) values can step backwards slightly
+                if (endCounts.v[e] > startCounts_.v[e]) acc.v[e] += endCounts.v[e] - startCounts_.v[e];
+            }
+        }
+    }
+    
+    ScopedPhase(const ScopedPhase&) = delete;
+    ScopedPhase& operator=(const ScopedPhase&) = delete;
+    
+private:
+    PhaseTimes& times_;
+    Phase phase_;
+    bool traced_;
+    PerfCounts startCounts_;
+    std::chrono::steady_clock::time_point start_;
+    
+    static uint64_t toNs(std::chrono::steady_clock::time_point t) {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count());
+    }
+};
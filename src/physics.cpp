@@ -1,6 +1,7 @@
 #include "physics.hpp"
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
 namespace physics {
 
@@ -11,7 +12,8 @@ void integrate(std::vector<Particle>& particles, float dt) {
     }
 }
 
-void handle_walls(std::vector<Particle>& particles, float box_w, float box_h, float r) {
+void handle_walls(std::vector<Particle>& particles, float box_w, float box_h, float r,
+                  StepEnergy* energy) {
     for (auto& p : particles) {
         //left wall
         if (p.x - r < 0.0f) {
@@ -37,6 +39,14 @@ void handle_walls(std::vector<Particle>& particles, float box_w, float box_h, fl
             p.vy = -p.vy;
             p.collided = true;
         }
+        // Fused here so energy tracking needs no pass of its own
+        if (energy) {
+            double vx = p.vx;
+            double vy = p.vy;
+            energy->kinetic.add(0.5 * (vx * vx + vy * vy));
+            energy->momentumX.add(vx);
+            energy->momentumY.add(vy);
+        }
     }
 }
 
@@ -48,7 +58,7 @@ bool circle_overlap(const Particle& a, const Particle& b) {
     return dist_sq < r_sum * r_sum;
 }
 
-void resolve_collision(Particle& a, Particle& b) {
+void resolve_collision(Particle& a, Particle& b, StepEnergy* energy) {
     float dx = b.x - a.x;
     float dy = b.y - a.y;
     float dist_sq = dx * dx + dy * dy;
@@ -69,11 +79,28 @@ void resolve_collision(Particle& a, Particle& b) {
     
     float impulse = dvn;
     
+    double before = 0.0;
+    if (energy) {
+        before = 0.5 * (static_cast<double>(a.vx) * a.vx + static_cast<double>(a.vy) * a.vy +
+                        static_cast<double>(b.vx) * b.vx + static_cast<double>(b.vy) * b.vy);
+        energy->momentumX.add(-(static_cast<double>(a.vx) + b.vx));
+        energy->momentumY.add(-(static_cast<double>(a.vy) + b.vy));
+    }
+    
     a.vx += impulse * nx;
     a.vy += impulse * ny;
     b.vx -= impulse * nx;
     b.vy -= impulse * ny;
     
+    // Account for the velocities after float rounding, not the exact impulse
+    if (energy) {
+        double after = 0.5 * (static_cast<double>(a.vx) * a.vx + static_cast<double>(a.vy) * a.vy +
+                              static_cast<double>(b.vx) * b.vx + static_cast<double>(b.vy) * b.vy);
+        energy->kinetic.add(after - before);
+        energy->momentumX.add(static_cast<double>(a.vx) + b.vx);
+        energy->momentumY.add(static_cast<double>(a.vy) + b.vy);
+    }
+    
     a.collided = true;
     b.collided = true;
 }
@@ -101,12 +128,40 @@ void positional_correction(Particle& a, Particle& b, float epsilon) {
     }
 }
 
-float total_energy(const std::vector<Particle>& particles) {
-    float energy = 0.0f;
+double contact_time(double dx, double dy, double dvx, double dvy, double sigma) {
+    double b = dx * dvx + dy * dvy;
+    if (b >= 0.0) return std::numeric_limits<double>::infinity();
+    double dv2 = dvx * dvx + dvy * dvy;
+    double gap = dx * dx + dy * dy - sigma * sigma;
+    double d = b * b - dv2 * gap;
+    if (d < 0.0) return std::numeric_limits<double>::infinity();
+    // Root of |dr + dv t| = sigma in the form that does not cancel
+    return std::max(gap / (-b + std::sqrt(d)), 0.0);
+}
+
+void elastic_bounce(double dx, double dy, double& avx, double& avy, double& bvx, double& bvy) {
+    double dist = std::sqrt(dx * dx + dy * dy);
+    double nx = 1.0;
+    double ny = 0.0;
+    if (dist > 0.0) {
+        nx = dx / dist;
+        ny = dy / dist;
+    }
+    double dvn = (bvx - avx) * nx + (bvy - avy) * ny;
+    avx += dvn * nx;
+    avy += dvn * ny;
+    bvx -= dvn * nx;
+    bvy -= dvn * ny;
+}
+
+double total_energy(const std::vector<Particle>& particles) {
+    KahanSum energy;
     for (const auto& p : particles) {
-        energy += 0.5f * (p.vx * p.vx + p.vy * p.vy);
+        double vx = p.vx;
+        double vy = p.vy;
+        energy.add(0.5 * (vx * vx + vy * vy));
     }
-    return energy;
+    return energy.value();
 }
 
 }
@@ -4,12 +4,44 @@
 #include <vector>
 
 namespace physics {
+    // Compensated (Kahan) sum in double
+    struct KahanSum {
+        double sum = 0.0;
+        double c = 0.0;
+        
+        void add(double x) {
+            double y = x - c;
+            double t = sum + y;
+            c = (t - sum) - y;
+            sum = t;
+        }
+        double value() const { return sum; }
+    };
+    
+    // Kinetic energy and momentum (unit mass) at the end of a step: summed in
+    // the walls pass, then corrected by each collision's velocity change
+    struct StepEnergy {
+        KahanSum kinetic;
+        KahanSum momentumX;
+        KahanSum momentumY;
+        
+        void reset() { *this = StepEnergy(); }
+    };
+    
     void integrate(std::vector<Particle>& particles, float dt);
-    void handle_walls(std::vector<Particle>& particles, float box_w, float box_h, float r);
+    void handle_walls(std::vector<Particle>& particles, float box_w, float box_h, float r,
+                      StepEnergy* energy = nullptr);
     bool circle_overlap(const Particle& a, const Particle& b);
-    void resolve_collision(Particle& a, Particle& b);
+    void resolve_collision(Particle& a, Particle& b, StepEnergy* energy = nullptr);
     void positional_correction(Particle& a, Particle& b, float epsilon = 0.01f);
-    float total_energy(const std::vector<Particle>& particles);
+    // Time until two discs with relative position (dx, dy) and velocity
+    // (dvx, dvy) are sigma apart while approaching: 0 if they already overlap
+    // and approach, infinity if they never meet
+    double contact_time(double dx, double dy, double dvx, double dvy, double sigma);
+    // Elastic contact of equal masses, b at (dx, dy) from a: exchanges the
+    // velocity components along that line (x if the centres coincide)
+    void elastic_bounce(double dx, double dy, double& avx, double& avy, double& bvx, double& bvy);
+    double total_energy(const std::vector<Particle>& particles);
 }
 
 
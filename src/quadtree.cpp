@@ -13,6 +13,10 @@ void Quadtree::clear() {
     root_ = make_unique<Node>(root_->x, root_->y, root_->w, root_->h);
 }
 
+void Quadtree::clear(float x, float y, float w, float h) {
+    root_ = make_unique<Node>(x, y, w, h);
+}
+
 bool Quadtree::insert(const BodyRef& b) {
     return insertRecursive(root_.get(), b, 0);
 }
@@ -87,17 +91,17 @@ void Quadtree::queryRecursive(const Node* node, float qx, float qy, float qr, st
         return;
     }
     
-    if (node->isLeaf) {
-        for (const auto& body : node->bodies) {
-            float dx = body.x - qx;
-            float dy = body.y - qy;
-            float dist_sq = dx * dx + dy * dy;
-            float r_sum = body.r + qr;
-            if (dist_sq < r_sum * r_sum) {
-                outIds.push_back(body.id);
-            }
+    // Internal nodes hold the bodies that straddle their children
+    for (const auto& body : node->bodies) {
+        float dx = body.x - qx;
+        float dy = body.y - qy;
+        float dist_sq = dx * dx + dy * dy;
+        float r_sum = body.r + qr;
+        if (dist_sq < r_sum * r_sum) {
+            outIds.push_back(body.id);
         }
-    } else {
+    }
+    if (!node->isLeaf) {
         for (int i = 0; i < 4; ++i) {
             if (node->children[i]) {
                 queryRecursive(node->children[i].get(), qx, qy, qr, outIds);
@@ -116,14 +120,14 @@ void Quadtree::queryAABBRecursive(const Node* node, float minX, float minY, floa
         return;
     }
     
-    if (node->isLeaf) {
-        for (const auto& body : node->bodies) {
-            if (body.x - body.r < maxX && body.x + body.r > minX &&
-                body.y - body.r < maxY && body.y + body.r > minY) {
-                outIds.push_back(body.id);
-            }
+    // Internal nodes hold the bodies that straddle their children
+    for (const auto& body : node->bodies) {
+        if (body.x - body.r < maxX && body.x + body.r > minX &&
+            body.y - body.r < maxY && body.y + body.r > minY) {
+            outIds.push_back(body.id);
         }
-    } else {
+    }
+    if (!node->isLeaf) {
         for (int i = 0; i < 4; ++i) {
             if (node->children[i]) {
                 queryAABBRecursive(node->children[i].get(), minX, minY, maxX, maxY, outIds);
@@ -156,3 +160,38 @@ void Quadtree::getBounds(float& x, float& y, float& w, float& h) const {
     h = root_->h;
 }
 
+
+void Quadtree::collectStats(BroadphaseStats& out) const {
+    out = BroadphaseStats();
+    out.kind = BroadphaseStats::Kind::Quadtree;
+    collectStatsRecursive(root_.get(), 0, out);
+}
+
+void Quadtree::collectStatsRecursive(const Node* node, int depth, BroadphaseStats& out) const {
+    out.nodes++;
+    out.maxDepth = std::max<uint64_t>(out.maxDepth, depth);
+    if (node->isLeaf) {
+        out.addOccupancy(node->bodies.size());
+        return;
+    }
+    out.internalBodies += node->bodies.size();
+    for (int i = 0; i < 4; ++i) {
+        if (node->children[i]) {
+            collectStatsRecursive(node->children[i].get(), depth + 1, out);
+        }
+    }
+}
+
+size_t Quadtree::memoryBytes() const {
+    return memoryBytesRecursive(root_.get());
+}
+
+size_t Quadtree::memoryBytesRecursive(const Node* node) const {
+    size_t bytes = sizeof(Node) + node->bodies.capacity() * sizeof(BodyRef);
+    for (int i = 0; i < 4; ++i) {
+        if (node->children[i]) {
+            bytes += memoryBytesRecursive(node->children[i].get());
+        }
+    }
+    return bytes;
+}
@@ -3,17 +3,21 @@
 #include <vector>
 #include <memory>
 #include "body_ref.hpp"
+#include "broadphase_stats.hpp"
 using namespace std;
 class Quadtree {
 public:
     Quadtree(float x, float y, float w, float h, int cap = 8, int maxDepth = 12);
     
     void clear();
+    void clear(float x, float y, float w, float h);   // Also moves the root to these bounds
     bool insert(const BodyRef& b);
     void update(const BodyRef& b);
     void query(float qx, float qy, float qr, std::vector<int>& outIds) const;
     void queryAABB(float minX, float minY, float maxX, float maxY, std::vector<int>& outIds) const;
     void getBounds(float& x, float& y, float& w, float& h) const;
+    void collectStats(BroadphaseStats& out) const;
+    size_t memoryBytes() const;  // Nodes and their body vectors
     
 private:
     struct Node {
@@ -33,6 +37,8 @@ private:
     bool contains(const Node* node, const BodyRef& b) const;
     bool intersects(const Node* node, float qx, float qy, float qr) const;
     bool intersectsAABB(const Node* node, float minX, float minY, float maxX, float maxY) const;
+    void collectStatsRecursive(const Node* node, int depth, BroadphaseStats& out) const;
+    size_t memoryBytesRecursive(const Node* node) const;
     
     unique_ptr<Node> root_;
     int capacity_;
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <random>
+#include <sstream>
+#include <string>
 
 class RNG {
 public:
@@ -19,7 +22,65 @@ public:
         return dist(gen_);
     }
     
+    // Generator state as text (std::mt19937_64 stream format), for checkpoints
+    std::string save() const {
+        std::ostringstream os;
+        os << gen_;
+        return os.str();
+    }
+    
+    bool load(const std::string& state) {
+        std::istringstream is(state);
+        is >> gen_;
+        return !is.fail();
+    }
+    
 private:
     std::mt19937_64 gen_;
     uint64_t seed_;
 };
+
+// Philox4x32-10 (Salmon et al., SC'11): a keyed bijection of a 128-bit counter
+// into four well-mixed 32-bit words
+inline std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> ctr, std::array<uint32_t, 2> key) {
+    for (int round = 0; round < 10; ++round) {
+        if (round > 0) {
+            key[0] += 0x9E3779B9u;
+            key[1] += 0xBB67AE85u;
+        }
+        uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * ctr[0];
+        uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * ctr[2];
+        ctr = {static_cast<uint32_t>(p1 >> 32) ^ ctr[1] ^ key[0], static_cast<uint32_t>(p1),
+               static_cast<uint32_t>(p0 >> 32) ^ ctr[3] ^ key[1], static_cast<uint32_t>(p0)};
+    }
+    return ctr;
+}
+
+// Counter-based generator keyed by (seed, id, stream). The n-th number of a
+// key is philox4x32 of (n / 4, id, stream) under the seed, so any thread can
+// produce any particle's numbers, in any order, with identical results.
+class CounterRNG {
+public:
+    CounterRNG(uint64_t seed, uint32_t id, uint32_t stream)
+        : key_{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}, ctr_{0, 0, id, stream} {}
+    
+    uint32_t next() {
+        if (used_ == 4) {
+            block_ = philox4x32(ctr_, key_);
+            if (++ctr_[0] == 0) ++ctr_[1];
+            used_ = 0;
+        }
+        return block_[used_++];
+    }
+    
+    // Top 24 bits scaled straight into [0, 1), every value exactly representable
+    float uniform01() { return static_cast<float>(next() >> 8) * (1.0f / 16777216.0f); }
+    
+    float uniform(float min = 0.0f, float max = 1.0f) { return min + (max - min) * uniform01(); }
+    
+private:
+    std::array<uint32_t, 2> key_;
+    std::array<uint32_t, 4> ctr_;
+    std::array<uint32_t, 4> block_{};
+    int used_ = 4;
+};
@@ -0,0 +1,281 @@
+#include "scaling.hpp"
+#include "engine.hpp"
+#include "particle.hpp"
+#include "init.hpp"
+#include "csv.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr double kMaxAreaFraction = 0.45;  // Leaves the lattice room to jitter
+constexpr int kWarmupSteps = 2;
+
+struct ScalingRun {
+    std::string method;
+    int N;
+    double density;       // Area fraction, fixed per series in density mode
+    float box_w, box_h;
+    // Results
+    int steps = 0;
+    double wallSeconds = 0.0;
+    double p50Ms = 0.0;
+    double nsPerParticleStep = 0.0;
+    double candPerParticle = 0.0;
+    bool cutOff = false;  // Stopped by --scaling_time before --steps
+};
+
+void runOne(ScalingRun& run, const SimConfig& config) {
+    std::vector<Particle> particles = latticeParticles(run.N, run.box_w, run.box_h, config.radius, config.seed);
+    std::unique_ptr<Engine> engine = makeEngine(run.method, run.box_w, run.box_h, config.radius);
+
+    for (int i = 0; i < kWarmupSteps; ++i) {
+        engine->step(particles, config.dt);
+    }
+
+    std::vector<double> stepMs;
+    uint64_t candidates = 0;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+    while (static_cast<int>(stepMs.size()) < std::max(config.steps, 1)) {
+        auto t0 = std::chrono::steady_clock::now();
+        engine->step(particles, config.dt);
+        auto t1 = std::chrono::steady_clock::now();
+        stepMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        candidates += engine->getCandidatePairsChecked();
+        elapsed = std::chrono::duration<double>(t1 - start).count();
+        if (elapsed >= config.scaling_time) break;
+    }
+
+    run.steps = static_cast<int>(stepMs.size());
+    run.wallSeconds = elapsed;
+    run.cutOff = run.steps < config.steps;
+    std::sort(stepMs.begin(), stepMs.end());
+    run.p50Ms = stepMs[stepMs.size() / 2];
+    run.nsPerParticleStep = run.p50Ms * 1e6 / run.N;
+    run.candPerParticle = static_cast<double>(candidates) / (static_cast<double>(run.N) * run.steps);
+}
+
+// Least-squares fit of log(ns per particle-step) = log(c) + k log(N)
+void fitPowerLaw(const std::vector<const ScalingRun*>& runs, double& c, double& k) {
+    double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (const ScalingRun* run : runs) {
+        double x = std::log(static_cast<double>(run->N));
+        double y = std::log(run->nsPerParticleStep);
+        n += 1; sx += x; sy += y; sxx += x * x; sxy += x * y;
+    }
+    double denom = n * sxx - sx * sx;
+    k = denom != 0.0 ? (n * sxy - sx * sy) / denom : 0.0;
+    c = n > 0 ? std::exp((sy - k * sx) / n) : 0.0;
+}
+
+// One series: every engine over N, at one density (density mode) or in the fixed box
+void reportSeries(std::ostream& os, const std::string& title, const std::vector<const ScalingRun*>& series,
+                  const std::vector<std::string>& methods) {
+    os << title << "\n";
+
+    // Table of ns per particle-step, one column per engine
+    std::map<int, std::map<std::string, const ScalingRun*>> byN;
+    for (const ScalingRun* run : series) byN[run->N][run->method] = run;
+    char line[256];
+    std::snprintf(line, sizeof(line), "  %10s", "N");
+    os << line;
+    for (const auto& m : methods) {
+        std::snprintf(line, sizeof(line), "  %14s", (m + "_ns").c_str());
+        os << line;
+    }
+    os << "  winner\n";
+    for (const auto& entry : byN) {
+        std::snprintf(line, sizeof(line), "  %10d", entry.first);
+        os << line;
+        const ScalingRun* best = nullptr;
+        for (const auto& m : methods) {
+            auto it = entry.second.find(m);
+            if (it == entry.second.end()) {
+                std::snprintf(line, sizeof(line), "  %14s", "-");
+            } else {
+                const ScalingRun* run = it->second;
+                std::snprintf(line, sizeof(line), "  %13.1f%s", run->nsPerParticleStep, run->cutOff ? "*" : " ");
+                if (!best || run->nsPerParticleStep < best->nsPerParticleStep) best = run;
+            }
+            os << line;
+        }
+        os << "  " << (best ? best->method : "-") << "\n";
+    }
+
+    // Power-law fit per engine
+    for (const auto& m : methods) {
+        std::vector<const ScalingRun*> runs;
+        for (const ScalingRun* run : series) {
+            if (run->method == m) runs.push_back(run);
+        }
+        if (runs.size() < 2) continue;
+        double c, k;
+        fitPowerLaw(runs, c, k);
+        std::snprintf(line, sizeof(line), "  fit %-10s ns/particle-step = %.3g * N^%.3f\n", m.c_str(), c, k);
+        os << line;
+    }
+
+    // Crossovers: sign changes of log(tA / tB) between neighbouring N,
+    // interpolated linearly in log N
+    for (size_t a = 0; a < methods.size(); ++a) {
+        for (size_t b = a + 1; b < methods.size(); ++b) {
+            std::vector<std::pair<double, double>> ratio;  // (log N, log tA/tB)
+            for (const auto& entry : byN) {
+                auto ia = entry.second.find(methods[a]);
+                auto ib = entry.second.find(methods[b]);
+                if (ia == entry.second.end() || ib == entry.second.end()) continue;
+                ratio.push_back({std::log(static_cast<double>(entry.first)),
+                                 std::log(ia->second->nsPerParticleStep / ib->second->nsPerParticleStep)});
+            }
+            if (ratio.empty()) continue;
+            bool crossed = false;
+            for (size_t i = 0; i + 1 < ratio.size(); ++i) {
+                double r0 = ratio[i].second, r1 = ratio[i + 1].second;
+                if ((r0 < 0) == (r1 < 0)) continue;
+                double logN = ratio[i].first + (ratio[i + 1].first - ratio[i].first) * r0 / (r0 - r1);
+                const std::string& below = r0 < 0 ? methods[a] : methods[b];
+                const std::string& above = r0 < 0 ? methods[b] : methods[a];
+                std::snprintf(line, sizeof(line), "  crossover %s/%s at N ~ %.3g: %s faster below, %s faster above\n",
+                              methods[a].c_str(), methods[b].c_str(), std::exp(logN), below.c_str(), above.c_str());
+                os << line;
+                crossed = true;
+            }
+            if (!crossed) {
+                const std::string& winner = ratio.front().second < 0 ? methods[a] : methods[b];
+                os << "  no crossover " << methods[a] << "/" << methods[b] << ": " << winner
+                   << " faster over the whole range\n";
+            }
+        }
+    }
+    os << "\n";
+}
+
+}
+
+int runScaling(const SimConfig& config) {
+    bool fixedDensity = config.scaling == "density";
+    if (!fixedDensity && config.scaling != "box") {
+        std::cerr << "Error: --scaling must be density or box" << std::endl;
+        return 1;
+    }
+    if (config.scaling_n_min < 1 || config.scaling_n_max < config.scaling_n_min) {
+        std::cerr << "Error: --scaling_n needs 1 <= min <= max" << std::endl;
+        return 1;
+    }
+
+    // N at half-decade steps: 100, 316, 1000, ...
+    std::vector<int> Ns;
+    for (double n = config.scaling_n_min; n <= config.scaling_n_max * 1.0001; n *= std::sqrt(10.0)) {
+        Ns.push_back(static_cast<int>(std::lround(n)));
+    }
+
+    const std::vector<std::string>& methods = engineNames();
+    const double particleArea = M_PI * config.radius * config.radius;
+    std::vector<double> densities = fixedDensity ? config.scaling_density : std::vector<double>{0.0};
+    std::vector<ScalingRun> runs;
+    for (double density : densities) {
+        for (int N : Ns) {
+            float box_w = config.box_w, box_h = config.box_h;
+            if (fixedDensity) {
+                // Keep the aspect ratio of --box
+                double area = N * particleArea / density;
+                double aspect = config.box_w / config.box_h;
+                box_w = static_cast<float>(std::sqrt(area * aspect));
+                box_h = static_cast<float>(std::sqrt(area / aspect));
+            }
+            double fraction = N * particleArea / (static_cast<double>(box_w) * box_h);
+            if (fraction > kMaxAreaFraction || !latticeFits(N, box_w, box_h, config.radius)) {
+                std::cerr << "Skipping N=" << N << ": area fraction " << fraction << " is too dense" << std::endl;
+                continue;
+            }
+            for (const auto& m : methods) {
+                ScalingRun run;
+                run.method = m;
+                run.N = N;
+                run.density = fixedDensity ? density : fraction;
+                run.box_w = box_w;
+                run.box_h = box_h;
+                runs.push_back(run);
+            }
+        }
+    }
+
+    // Largest runs first so the long ones do not trail at the end
+    std::vector<size_t> order(runs.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return runs[a].N > runs[b].N; });
+
+    int jobs = config.scaling_jobs > 0 ? config.scaling_jobs
+                                       : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    jobs = std::min<int>(jobs, static_cast<int>(runs.size()));
+    std::cout << "Scaling sweep: " << runs.size() << " runs, " << jobs << " at a time, up to "
+              << config.scaling_time << " s each" << std::endl;
+
+    std::atomic<size_t> next{0};
+    std::mutex printMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < order.size(); i = next++) {
+            ScalingRun& run = runs[order[i]];
+            runOne(run, config);
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "  method=" << run.method << " N=" << run.N << " steps=" << run.steps
+                      << " ns_per_particle_step=" << run.nsPerParticleStep << std::endl;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < jobs; ++t) threads.emplace_back(worker);
+    for (auto& t : threads) t.join();
+
+    CSVWriter csv(config.outdir + "/scaling.csv");
+    for (const char* column : {"mode", "method", "N", "density", "box_w", "box_h", "radius", "steps",
+                               "wall_s", "step_p50_ms", "ns_per_particle_step", "cand_per_particle",
+                               "cut_off", "concurrent_runs"}) {
+        csv.field(column);
+    }
+    csv.endRow();
+    for (const auto& run : runs) {
+        csv.field(config.scaling).field(run.method).field(run.N).field(run.density, 4)
+           .field(static_cast<double>(run.box_w), 2).field(static_cast<double>(run.box_h), 2)
+           .field(static_cast<double>(config.radius), 3).field(run.steps).field(run.wallSeconds, 3)
+           .field(run.p50Ms, 4).field(run.nsPerParticleStep, 2).field(run.candPerParticle, 3)
+           .field(run.cutOff ? 1 : 0).field(jobs);
+        csv.endRow();
+    }
+    csv.flush();
+
+    std::string reportFile = config.outdir + "/scaling_report.txt";
+    std::ofstream report(reportFile);
+    report << "Scaling sweep (--scaling " << config.scaling << "), radius " << config.radius
+           << ", dt " << config.dt << ", up to " << config.scaling_time << " s or " << config.steps
+           << " steps per run, " << jobs << " runs at a time\n"
+           << "Median step time per particle in ns; * = cut off by wall time\n\n";
+    for (double density : densities) {
+        std::vector<const ScalingRun*> series;
+        for (const auto& run : runs) {
+            if (!fixedDensity || run.density == density) series.push_back(&run);
+        }
+        char title[128];
+        if (fixedDensity) {
+            std::snprintf(title, sizeof(title), "Area fraction %.4g", density);
+        } else {
+            std::snprintf(title, sizeof(title), "Fixed box %gx%g", config.box_w, config.box_h);
+        }
+        reportSeries(report, title, series, methods);
+    }
+    report.close();
+    std::cout << "Scaling results written to " << config.outdir << "/scaling.csv and " << reportFile << std::endl;
+    return 0;
+}
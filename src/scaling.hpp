@@ -0,0 +1,17 @@
+#pragma once
+
+#include "sim_config.hpp"
+
+// Scaling sweep (--scaling {density|box})
+//
+// Runs every engine at geometrically spaced N (half-decade steps between
+// --scaling_n min and max), either growing the box to hold the area fraction
+// of each --scaling_density, or keeping --box fixed. Each run places its
+// particles on a jittered lattice (O(N), so 1e6 is practical), takes a couple
+// of untimed warm-up steps and then steps until --scaling_time seconds or
+// --steps steps have passed. Independent runs share the cores, largest first.
+//
+// Writes <outdir>/scaling.csv (one row per run) and <outdir>/scaling_report.txt
+// with a power-law fit of time per particle-step for each engine and the N at
+// which each pair of engines trades places. Returns the process exit code.
+int runScaling(const SimConfig& config);
@@ -0,0 +1,220 @@
+#include "shm_stream.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+size_t payloadBytes(uint64_t N) {
+    return 4 * N * sizeof(float) + (N + 7) / 8;
+}
+
+size_t slotBytes(uint64_t N) {
+    size_t bytes = sizeof(ShmSlotHeader) + payloadBytes(N);
+    return (bytes + 63) & ~size_t(63);
+}
+
+}
+
+ShmStreamWriter::ShmStreamWriter(const std::string& name, int N, float box_w, float box_h,
+                                 float radius, float dt, int slotCount)
+    : name_("/" + name), base_(nullptr), size_(0), header_(nullptr), published_(0) {
+    slotCount = std::max(slotCount, 2);
+    size_ = sizeof(ShmStreamHeader) + static_cast<size_t>(slotCount) * slotBytes(N);
+
+    int fd = shm_open(name_.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Warning: Could not create shared memory stream " << name_ << ": "
+                  << std::strerror(errno) << std::endl;
+        return;
+    }
+    if (ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+        std::cerr << "Warning: Could not size shared memory stream " << name_ << std::endl;
+        ::close(fd);
+        shm_unlink(name_.c_str());
+        return;
+    }
+    void* mapped = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Warning: Could not map shared memory stream " << name_ << std::endl;
+        shm_unlink(name_.c_str());
+        return;
+    }
+    base_ = static_cast<unsigned char*>(mapped);
+
+    header_ = new (base_) ShmStreamHeader();
+    header_->version = 1;
+    header_->slot_count = static_cast<uint32_t>(slotCount);
+    header_->N = static_cast<uint64_t>(N);
+    header_->slot_bytes = slotBytes(N);
+    header_->box_w = box_w;
+    header_->box_h = box_h;
+    header_->radius = radius;
+    header_->dt = dt;
+    header_->published.store(0, std::memory_order_relaxed);
+    for (int s = 0; s < slotCount; ++s) {
+        auto* slot = new (base_ + sizeof(ShmStreamHeader) + s * header_->slot_bytes) ShmSlotHeader();
+        slot->seq.store(0, std::memory_order_relaxed);
+    }
+    // Readers check the magic first, so it goes in last
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header_->magic, "PBSHM01", 8);
+}
+
+ShmStreamWriter::~ShmStreamWriter() {
+    if (base_) {
+        munmap(base_, size_);
+        shm_unlink(name_.c_str());
+    }
+}
+
+void ShmStreamWriter::publish(int step, double time, const std::vector<Particle>& particles) {
+    if (!base_) return;
+
+    const uint64_t N = header_->N;
+    const uint64_t k = published_;
+    unsigned char* slotBase = base_ + sizeof(ShmStreamHeader) + (k % header_->slot_count) * header_->slot_bytes;
+    auto* slot = reinterpret_cast<ShmSlotHeader*>(slotBase);
+
+    slot->seq.store(2 * k + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->index = k;
+    slot->step = static_cast<uint64_t>(step);
+    slot->time = time;
+    float* x = reinterpret_cast<float*>(slotBase + sizeof(ShmSlotHeader));
+    float* y = x + N;
+    float* vx = y + N;
+    float* vy = vx + N;
+    uint8_t* bits = reinterpret_cast<uint8_t*>(vy + N);
+    std::memset(bits, 0, (N + 7) / 8);
+    size_t count = std::min<size_t>(N, particles.size());
+    for (size_t i = 0; i < count; ++i) {
+        const auto& p = particles[i];
+        x[i] = p.x;
+        y[i] = p.y;
+        vx[i] = p.vx;
+        vy[i] = p.vy;
+        if (p.collided) {
+            bits[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+        }
+    }
+
+    slot->seq.store(2 * k + 2, std::memory_order_release);
+    published_ = k + 1;
+    header_->published.store(published_, std::memory_order_release);
+}
+
+ShmStreamReader::ShmStreamReader(const std::string& name)
+    : base_(nullptr), size_(0), header_(nullptr), next_(0) {
+    std::string shmName = "/" + name;
+    int fd = shm_open(shmName.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        std::cerr << "Warning: No shared memory stream " << shmName << std::endl;
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmStreamHeader)) {
+        ::close(fd);
+        std::cerr << "Warning: Shared memory stream " << shmName << " is not initialized" << std::endl;
+        return;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Warning: Could not map shared memory stream " << shmName << std::endl;
+        size_ = 0;
+        return;
+    }
+    base_ = static_cast<unsigned char*>(mapped);
+    header_ = reinterpret_cast<const ShmStreamHeader*>(base_);
+
+    if (std::memcmp(header_->magic, "PBSHM01", 8) != 0 ||
+        sizeof(ShmStreamHeader) + header_->slot_count * header_->slot_bytes > size_) {
+        std::cerr << "Warning: " << shmName << " is not a particle-box stream" << std::endl;
+        munmap(base_, size_);
+        base_ = nullptr;
+        header_ = nullptr;
+        size_ = 0;
+        return;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    next_ = published();
+}
+
+ShmStreamReader::~ShmStreamReader() {
+    if (base_) {
+        munmap(base_, size_);
+    }
+}
+
+bool ShmStreamReader::readSlot(uint64_t index, StreamSnapshot& out) const {
+    const uint64_t N = header_->N;
+    const unsigned char* slotBase = base_ + sizeof(ShmStreamHeader) + (index % header_->slot_count) * header_->slot_bytes;
+    const auto* slot = reinterpret_cast<const ShmSlotHeader*>(slotBase);
+
+    uint64_t before = slot->seq.load(std::memory_order_acquire);
+    if (before != 2 * index + 2) {
+        return false;  // Not published yet, being rewritten, or already overwritten
+    }
+
+    const float* x = reinterpret_cast<const float*>(slotBase + sizeof(ShmSlotHeader));
+    const uint8_t* bits = reinterpret_cast<const uint8_t*>(x + 4 * N);
+    out.x.assign(x, x + N);
+    out.y.assign(x + N, x + 2 * N);
+    out.vx.assign(x + 2 * N, x + 3 * N);
+    out.vy.assign(x + 3 * N, x + 4 * N);
+    out.collided.assign(bits, bits + (N + 7) / 8);
+    out.index = slot->index;
+    out.step = slot->step;
+    out.time = slot->time;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot->seq.load(std::memory_order_relaxed) == before;
+}
+
+bool ShmStreamReader::readLatest(StreamSnapshot& out) {
+    if (!base_) return false;
+    while (true) {
+        uint64_t available = published();
+        if (available == 0) return false;
+        if (readSlot(available - 1, out)) {
+            next_ = available;
+            return true;
+        }
+        // The producer lapped us while copying; retry with the newer snapshot
+    }
+}
+
+bool ShmStreamReader::readNext(StreamSnapshot& out, uint64_t* dropped) {
+    if (!base_) return false;
+    uint64_t skipped = 0;
+    while (true) {
+        uint64_t available = published();
+        if (next_ >= available) {
+            if (dropped) *dropped = skipped;
+            return false;
+        }
+        // Keep one slot of margin: the producer may already be rewriting the oldest
+        uint64_t oldest = available > header_->slot_count - 1 ? available - (header_->slot_count - 1) : 0;
+        if (next_ < oldest) {
+            skipped += oldest - next_;
+            next_ = oldest;
+        }
+        if (readSlot(next_, out)) {
+            next_++;
+            if (dropped) *dropped = skipped;
+            return true;
+        }
+        skipped++;
+        next_++;
+    }
+}
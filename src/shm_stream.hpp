@@ -0,0 +1,108 @@
+#pragma once
+
+#include "particle.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Live state stream over POSIX shared memory (--stream shm:<name>)
+//
+// One producer (the step loop) publishes snapshots into a ring of slots; any
+// number of readers copy them out. Each slot is guarded by a seqlock: the
+// producer makes the slot's sequence odd while it writes and even when the
+// snapshot is complete, and a reader keeps a copy only if it saw the same even
+// sequence before and after copying. The producer never waits for readers; a
+// reader that falls more than slot_count snapshots behind skips ahead.
+//
+// Segment layout:
+//   [ShmStreamHeader]                                   128 bytes
+//   slot_count x { [ShmSlotHeader] 64 bytes,
+//                  float x[N], y[N], vx[N], vy[N], uint8 collided[ceil(N/8)],
+//                  padded to slot_bytes }
+
+struct ShmStreamHeader {
+    char magic[8];                        // "PBSHM01\0"
+    uint32_t version;
+    uint32_t slot_count;
+    uint64_t N;
+    uint64_t slot_bytes;                  // Slot header plus payload, 64-byte aligned
+    float box_w, box_h;
+    float radius;
+    float dt;
+    std::atomic<uint64_t> published;      // Number of snapshots published so far
+    char reserved[128 - 56];
+};
+
+struct ShmSlotHeader {
+    std::atomic<uint64_t> seq;            // Odd while being written
+    uint64_t index;                       // Snapshot number
+    uint64_t step;
+    double time;
+    char reserved[64 - 32];
+};
+
+static_assert(sizeof(ShmStreamHeader) == 128, "ShmStreamHeader must stay 128 bytes");
+static_assert(sizeof(ShmSlotHeader) == 64, "ShmSlotHeader must stay 64 bytes");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory seqlock needs lock-free 64-bit atomics");
+
+struct StreamSnapshot {
+    uint64_t index = 0;
+    uint64_t step = 0;
+    double time = 0.0;
+    std::vector<float> x, y, vx, vy;
+    std::vector<uint8_t> collided;        // Packed bitset
+
+    bool isCollided(size_t i) const { return (collided[i >> 3] >> (i & 7)) & 1u; }
+};
+
+class ShmStreamWriter {
+public:
+    // name is the shm_open() name without the leading '/'
+    ShmStreamWriter(const std::string& name, int N, float box_w, float box_h, float radius,
+                    float dt, int slotCount = 8);
+    ~ShmStreamWriter();  // Unlinks the segment; attached readers keep their mapping
+
+    ShmStreamWriter(const ShmStreamWriter&) = delete;
+    ShmStreamWriter& operator=(const ShmStreamWriter&) = delete;
+
+    void publish(int step, double time, const std::vector<Particle>& particles);
+    bool isOpen() const { return base_ != nullptr; }
+
+private:
+    std::string name_;
+    unsigned char* base_;
+    size_t size_;
+    ShmStreamHeader* header_;
+    uint64_t published_;
+};
+
+class ShmStreamReader {
+public:
+    explicit ShmStreamReader(const std::string& name);
+    ~ShmStreamReader();
+
+    ShmStreamReader(const ShmStreamReader&) = delete;
+    ShmStreamReader& operator=(const ShmStreamReader&) = delete;
+
+    bool isOpen() const { return base_ != nullptr; }
+    uint64_t N() const { return header_->N; }
+    float boxWidth() const { return header_->box_w; }
+    float boxHeight() const { return header_->box_h; }
+    uint64_t published() const { return header_->published.load(std::memory_order_acquire); }
+
+    // Most recent complete snapshot
+    bool readLatest(StreamSnapshot& out);
+    // Snapshot after the last one returned; false if none is ready yet.
+    // dropped counts snapshots that were overwritten before they could be read.
+    bool readNext(StreamSnapshot& out, uint64_t* dropped = nullptr);
+
+private:
+    unsigned char* base_;
+    size_t size_;
+    const ShmStreamHeader* header_;
+    uint64_t next_;
+
+    bool readSlot(uint64_t index, StreamSnapshot& out) const;
+};
@@ -3,9 +3,10 @@
 
 #include <string>
 #include <cstdint>
+#include <vector>
 
 struct SimConfig {
-    std::string method = "quadtree";  //"quadtree" or "hash"
+    std::string method = "quadtree";  //"quadtree", "hash", "auto", "brute" or "event"
     int N = 100;                      //number of particles
     float radius = 5.0f;              //particle radius
     float box_w = 800.0f;              //box width
@@ -17,8 +18,38 @@ struct SimConfig {
     bool headless = false;            //no rendering
     std::string outdir = ".";         //output directory
     bool log_pairs = false;           //log candidate pairs
+    double log_pairs_sample = 1.0;    //fraction of candidate pairs kept in pairs.bin
+    std::string export_pairs;         //convert this pairs.bin to CSV and exit
     bool no_energy = false;           //skip energy calculations
     bool summary_only = false;         //only write summary.csv, no per-step logs
+    std::string format = "csv";       //per-step log format: "csv", "bin" or "delta"
+    int keyframe_every = 64;          //delta format: full keyframe every K frames
+    int quant_bits = 20;              //delta format: fixed-point bits per box dimension
+    int checkpoint_every = 0;         //write <outdir>/checkpoint.bin every N steps (0 = off)
+    std::string restart;              //resume from this checkpoint file
+    std::string stream;               //live snapshots, "shm:<name>"
+    int stream_every = 1;             //publish a snapshot every N steps
+    int hist_digits = 3;              //significant digits kept by the latency histograms
+    bool perf_counters = false;       //read hardware counters around each engine phase
+    std::string trace;                //Chrome trace JSON output file (empty = off)
+    int trace_sample = 1;             //trace every Nth step
+    bool broadphase_stats = false;    //per-step broad-phase structure stats (broadphase.csv)
+    int metrics_port = 0;             //serve Prometheus metrics on 127.0.0.1:<port> (0 = off)
+    std::string init_mode = "random"; //initial placement: "random", "tiled" or "lattice"
+    std::string init_file;            //start from the particles in this checkpoint, trajectory or CSV
+    bool ccd = false;                 //quadtree/hash: swept-circle collisions in time-of-impact order
+    int threads = 0;                  //worker threads of --method brute, --verify_broadphase and init (0 = one per core)
+    int verify_broadphase = 0;        //check candidates against brute force every N steps (0 = off)
+    int auto_probe_every = 100;       //--method auto: steps between cost probes of the other engines
+    bool autotune = false;            //time a parameter grid for the broad phase before the run
+    int autotune_steps = 5;           //timed trial steps per candidate setting
+    int autotune_every = 0;           //check for re-tuning every N steps (0 = only at startup)
+    std::string scaling;              //scaling sweep: "density" or "box" (empty = normal run)
+    std::vector<double> scaling_density = {0.05};  //area fractions swept in density mode
+    int scaling_n_min = 100;          //smallest N of the sweep
+    int scaling_n_max = 1000000;      //largest N of the sweep
+    float scaling_time = 2.0f;        //wall-time cutoff per sweep run (seconds)
+    int scaling_jobs = 0;             //concurrent sweep runs (0 = one per core)
 };
 
 #endif
@@ -4,8 +4,9 @@
 #include <cstdlib>
 #include <set>
 
-SpatialHash::SpatialHash(float cellSize)
-    : cellSize_(std::max(cellSize, 1.0f)), tableSize_(256), itemCount_(0) {
+SpatialHash::SpatialHash(float cellSize, int initialTableSize, float maxLoad)
+    : cellSize_(std::max(cellSize, 1.0f)), tableSize_(std::max(initialTableSize, 16)), itemCount_(0), resizes_(0),
+      maxLoad_(std::min(std::max(maxLoad, 0.1f), 0.95f)), maxRadius_(0.0f) {
     table_.resize(tableSize_);
 }
 
@@ -15,6 +16,12 @@ void SpatialHash::clear() {
         cell.occupied = false;
     }
     itemCount_ = 0;
+    maxRadius_ = 0.0f;
+}
+
+void SpatialHash::clear(float cellSize) {
+    clear();
+    cellSize_ = std::max(cellSize, 1.0f);
 }
 
 uint64_t SpatialHash::splitmix64(uint64_t x) {
@@ -70,6 +77,7 @@ void SpatialHash::resize() {
     int oldSize = tableSize_;
     
     tableSize_ *= 2;
+    resizes_++;
     table_.clear();
     table_.resize(tableSize_);
     itemCount_ = 0;
@@ -86,10 +94,12 @@ void SpatialHash::resize() {
 
 void SpatialHash::insert(const BodyRef& b) {
     // Check if resize needed
-    if (itemCount_ >= tableSize_ * LOAD_FACTOR) {
+    if (itemCount_ >= tableSize_ * maxLoad_) {
         resize();
     }
     
+    maxRadius_ = std::max(maxRadius_, b.r);
+    
     // Calculate grid cell
     int i = static_cast<int>(std::floor(b.x / cellSize_));
     int j = static_cast<int>(std::floor(b.y / cellSize_));
@@ -162,3 +172,81 @@ void SpatialHash::query(float qx, float qy, float qr, std::vector<int>& outIds)
         outIds.push_back(id);
     }
 }
+
+const SpatialHash::Cell* SpatialHash::findCell(int i, int j) const {
+    HashKey key(i, j);
+    int slot = hashKey(key) % tableSize_;
+    int startSlot = slot;
+    while (table_[slot].occupied) {
+        if (table_[slot].key == key) {
+            return &table_[slot];
+        }
+        slot = (slot + 1) % tableSize_;
+        if (slot == startSlot) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+void SpatialHash::queryAABB(float minX, float minY, float maxX, float maxY, std::vector<int>& outIds) const {
+    outIds.clear();
+    
+    // Bodies are filed under the cell of their centre, so reach out by the
+    // largest radius; every body sits in one cell, so no duplicates
+    int minI = static_cast<int>(std::floor((minX - maxRadius_) / cellSize_));
+    int maxI = static_cast<int>(std::floor((maxX + maxRadius_) / cellSize_));
+    int minJ = static_cast<int>(std::floor((minY - maxRadius_) / cellSize_));
+    int maxJ = static_cast<int>(std::floor((maxY + maxRadius_) / cellSize_));
+    auto collect = [&](const Cell& cell) {
+        for (const auto& body : cell.bodies) {
+            if (body.x - body.r < maxX && body.x + body.r > minX &&
+                body.y - body.r < maxY && body.y + body.r > minY) {
+                outIds.push_back(body.id);
+            }
+        }
+    };
+    
+    // A box spanning more cells than the table has slots is cheaper to answer by a scan
+    int64_t spanned = (static_cast<int64_t>(maxI) - minI + 1) * (static_cast<int64_t>(maxJ) - minJ + 1);
+    if (spanned > tableSize_) {
+        for (const auto& cell : table_) {
+            if (cell.occupied && cell.key.i >= minI && cell.key.i <= maxI &&
+                cell.key.j >= minJ && cell.key.j <= maxJ) {
+                collect(cell);
+            }
+        }
+        return;
+    }
+    for (int i = minI; i <= maxI; ++i) {
+        for (int j = minJ; j <= maxJ; ++j) {
+            if (const Cell* cell = findCell(i, j)) {
+                collect(*cell);
+            }
+        }
+    }
+}
+
+void SpatialHash::collectStats(BroadphaseStats& out) const {
+    out = BroadphaseStats();
+    out.kind = BroadphaseStats::Kind::Hash;
+    out.tableSize = static_cast<uint64_t>(tableSize_);
+    out.resizes = static_cast<uint64_t>(resizes_);
+    for (int slot = 0; slot < tableSize_; ++slot) {
+        const Cell& cell = table_[slot];
+        if (!cell.occupied) continue;
+        out.addOccupancy(cell.bodies.size());
+        int home = static_cast<int>(hashKey(cell.key) % tableSize_);
+        uint64_t probe = static_cast<uint64_t>((slot - home + tableSize_) % tableSize_);
+        out.probeTotal += probe;
+        out.maxProbe = std::max(out.maxProbe, probe);
+    }
+}
+
+size_t SpatialHash::memoryBytes() const {
+    size_t bytes = table_.capacity() * sizeof(Cell);
+    for (const auto& cell : table_) {
+        bytes += cell.bodies.capacity() * sizeof(BodyRef);
+    }
+    return bytes;
+}
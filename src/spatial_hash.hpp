@@ -1,18 +1,25 @@
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <cstdint>
 #include "body_ref.hpp"
+#include "broadphase_stats.hpp"
 
 class SpatialHash {
 public:
-    SpatialHash(float cellSize);
+    SpatialHash(float cellSize, int initialTableSize = 256, float maxLoad = 0.75f);
     
     void clear();
+    void clear(float cellSize);   // Also files the next inserts under cells of this size
     void insert(const BodyRef& b);
     void query(float qx, float qy, float qr, std::vector<int>& outIds) const;
+    // Bodies whose bounding box overlaps the box, each once (any radius)
+    void queryAABB(float minX, float minY, float maxX, float maxY, std::vector<int>& outIds) const;
     
     float getCellSize() const { return cellSize_; }
+    void collectStats(BroadphaseStats& out) const;
+    size_t memoryBytes() const;  // Table and per-cell body vectors
     
 private:
     struct HashKey {
@@ -34,13 +41,16 @@ private:
     
     uint64_t hashKey(const HashKey& key) const;
     int findSlot(uint64_t hash, const HashKey& key) const;
+    const Cell* findCell(int i, int j) const;
     void resize();
     
     std::vector<Cell> table_;
     float cellSize_;
     int tableSize_;
     int itemCount_;
-    static constexpr float LOAD_FACTOR = 0.75f;
+    int resizes_;
+    float maxLoad_;      // Occupied-slot fraction that triggers a resize
+    float maxRadius_;    // Largest radius inserted since clear()
     
     // Splitmix64 hash function
     static uint64_t splitmix64(uint64_t x);
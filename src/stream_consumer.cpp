@@ -0,0 +1,90 @@
+// Sample consumer for --stream shm:<name>: prints one line of summary
+// statistics per snapshot until the simulation stops publishing.
+//
+//   particle-box-stream <name> [--latest] [--idle_ms <int>]
+
+#include "shm_stream.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <name> [--latest] [--idle_ms <int>]\n"
+                  << "  <name>          Stream name given to particle-box --stream shm:<name>\n"
+                  << "  --latest        Only show the newest snapshot instead of every one\n"
+                  << "  --idle_ms <int> Exit after this long without a new snapshot (default: 2000)\n";
+        return 1;
+    }
+
+    std::string name = argv[1];
+    if (name.rfind("shm:", 0) == 0) {
+        name = name.substr(4);
+    }
+    bool latestOnly = false;
+    int idleMs = 2000;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--latest") {
+            latestOnly = true;
+        } else if (arg == "--idle_ms" && i + 1 < argc) {
+            idleMs = std::atoi(argv[++i]);
+        }
+    }
+
+    ShmStreamReader reader(name);
+    if (!reader.isOpen()) {
+        return 1;
+    }
+
+    StreamSnapshot snap;
+    uint64_t lastIndex = UINT64_MAX;
+    uint64_t totalDropped = 0;
+    auto lastSeen = std::chrono::steady_clock::now();
+
+    std::cout << std::fixed << std::setprecision(3);
+    while (true) {
+        uint64_t dropped = 0;
+        bool got = latestOnly ? reader.readLatest(snap) && snap.index != lastIndex
+                              : reader.readNext(snap, &dropped);
+        totalDropped += dropped;
+
+        if (!got) {
+            auto idle = std::chrono::steady_clock::now() - lastSeen;
+            if (std::chrono::duration_cast<std::chrono::milliseconds>(idle).count() > idleMs) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        lastSeen = std::chrono::steady_clock::now();
+        lastIndex = snap.index;
+
+        double energy = 0.0;
+        double meanSpeed = 0.0;
+        size_t collided = 0;
+        for (size_t i = 0; i < snap.x.size(); ++i) {
+            double v2 = static_cast<double>(snap.vx[i]) * snap.vx[i] + static_cast<double>(snap.vy[i]) * snap.vy[i];
+            energy += 0.5 * v2;
+            meanSpeed += std::sqrt(v2);
+            collided += snap.isCollided(i) ? 1 : 0;
+        }
+        if (!snap.x.empty()) {
+            meanSpeed /= snap.x.size();
+        }
+
+        std::cout << "snapshot=" << snap.index
+                  << " step=" << snap.step
+                  << " t=" << snap.time
+                  << " energy=" << energy
+                  << " mean_speed=" << meanSpeed
+                  << " collided=" << collided
+                  << " dropped=" << totalDropped << "\n";
+    }
+    std::cout << std::flush;
+    return 0;
+}
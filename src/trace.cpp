@@ -0,0 +1,162 @@
+#include "trace.hpp"
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+namespace detail {
+std::atomic<bool> active{false};
+}
+
+namespace {
+
+struct Event {
+    const char* name;
+    const char* category;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+constexpr size_t kChunkEvents = 4096;
+
+// Filled in chunks so short-lived threads cost little memory
+struct ThreadBuffer {
+    uint32_t tid;
+    std::string name;
+    bool inUse = true;
+    std::vector<std::unique_ptr<Event[]>> chunks;
+    std::atomic<size_t> count{0};
+    std::atomic<uint64_t> dropped{0};
+};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;  // Buffers outlive their threads
+bool started = false;
+size_t capacityPerThread = 0;
+uint64_t originNs = 0;
+
+// Hands the buffer back when its thread exits, so the next short-lived
+// thread (e.g. one checkpoint write) continues in it instead of a new one
+struct LocalBuffer {
+    ThreadBuffer* buf = nullptr;
+    ~LocalBuffer() {
+        if (buf) {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buf->inUse = false;
+        }
+    }
+};
+
+thread_local LocalBuffer localBuffer;
+
+ThreadBuffer* buffer() {
+    if (!localBuffer.buf) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto& buf : registry) {
+            if (!buf->inUse) {
+                buf->inUse = true;
+                localBuffer.buf = buf.get();
+                return localBuffer.buf;
+            }
+        }
+        auto buf = std::make_unique<ThreadBuffer>();
+        buf->tid = static_cast<uint32_t>(registry.size() + 1);
+        buf->name = "thread-" + std::to_string(buf->tid);
+        localBuffer.buf = buf.get();
+        registry.push_back(std::move(buf));
+    }
+    return localBuffer.buf;
+}
+
+void writeEscaped(std::FILE* f, const std::string& s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') std::fputc('\\', f);
+        std::fputc(c, f);
+    }
+}
+
+}
+
+void start(size_t maxEventsPerThread) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    started = true;
+    capacityPerThread = maxEventsPerThread > 0 ? maxEventsPerThread : 1;
+    originNs = nowNs();
+    detail::active.store(true, std::memory_order_relaxed);
+}
+
+void setSampled(bool sampled) {
+    detail::active.store(started && sampled, std::memory_order_relaxed);
+}
+
+void setThreadName(const char* name) {
+    if (!started) return;
+    ThreadBuffer* buf = buffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buf->name = name;
+}
+
+void record(const char* name, const char* category, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer* buf = buffer();
+    size_t n = buf->count.load(std::memory_order_relaxed);
+    if (n >= capacityPerThread) {
+        buf->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (n / kChunkEvents == buf->chunks.size()) {
+        buf->chunks.emplace_back(new Event[kChunkEvents]);
+    }
+    buf->chunks[n / kChunkEvents][n % kChunkEvents] = {name, category, startNs, endNs};
+    buf->count.store(n + 1, std::memory_order_release);
+}
+
+bool write(const std::string& filename) {
+    std::FILE* f = std::fopen(filename.c_str(), "w");
+    if (!f) {
+        std::cerr << "Warning: Could not open trace file: " << filename << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    uint64_t dropped = 0;
+    bool first = true;
+    auto separator = [&]() {
+        std::fputs(first ? "\n" : ",\n", f);
+        first = false;
+    };
+
+    std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+    for (const auto& buf : registry) {
+        separator();
+        std::fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", buf->tid);
+        writeEscaped(f, buf->name);
+        std::fputs("\"}}", f);
+
+        size_t n = buf->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; ++i) {
+            const Event& e = buf->chunks[i / kChunkEvents][i % kChunkEvents];
+            // Timestamps in microseconds since start(), ns precision
+            double ts = (static_cast<int64_t>(e.startNs - originNs)) / 1000.0;
+            double dur = (e.endNs - e.startNs) / 1000.0;
+            separator();
+            std::fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                            "\"ts\":%.3f,\"dur\":%.3f}",
+                         e.name, e.category, buf->tid, ts, dur);
+        }
+        dropped += buf->dropped.load(std::memory_order_relaxed);
+    }
+    std::fprintf(f, "\n],\"otherData\":{\"dropped_events\":\"%llu\"}}\n",
+                 static_cast<unsigned long long>(dropped));
+
+    bool ok = std::ferror(f) == 0;
+    ok = std::fclose(f) == 0 && ok;
+    if (dropped > 0) {
+        std::cerr << "Warning: Trace buffers filled up; " << dropped << " events dropped" << std::endl;
+    }
+    return ok;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Timeline tracing (--trace <file>)
+//
+// Every thread that records gets its own event buffer, registered once under
+// a mutex and handed on to the next thread when it exits; after that record()
+// is a plain store into memory only that thread writes, with the count
+// published by a release store. Events are complete spans ("X" events: name,
+// category, start, duration); write() dumps them as Chrome Trace Event JSON,
+// which chrome://tracing and ui.perfetto.dev load directly.
+//
+// Bounded output: with setSampled() the step loop turns recording off for the
+// steps it does not sample, and each thread stops recording once its buffer
+// is full (the dropped count goes into the file's metadata).
+
+namespace trace {
+
+// Enables recording; maxEventsPerThread bounds the memory of each thread
+void start(size_t maxEventsPerThread = 1 << 20);
+
+namespace detail {
+extern std::atomic<bool> active;
+}
+
+// True while recording is started and the current step is sampled
+inline bool active() { return detail::active.load(std::memory_order_relaxed); }
+
+void setSampled(bool sampled);
+
+// Name shown for the calling thread (e.g. "main", "pair-log")
+void setThreadName(const char* name);
+
+inline uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// name and category must be string literals (only the pointer is stored)
+void record(const char* name, const char* category, uint64_t startNs, uint64_t endNs);
+
+// Writes everything recorded so far; call once the recording threads are
+// idle (buffers grow by chunks, which write() must not race with)
+bool write(const std::string& filename);
+
+// Records the lifetime of the scope when tracing is active at its start
+class Scope {
+public:
+    Scope(const char* name, const char* category)
+        : name_(name), category_(category), start_(active() ? nowNs() : 0) {}
+
+    ~Scope() {
+        if (start_ != 0) record(name_, category_, start_, nowNs());
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    const char* category_;
+    uint64_t start_;
+};
+
+}
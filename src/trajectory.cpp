@@ -0,0 +1,224 @@
+#include "trajectory.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TrajectoryWriter::TrajectoryWriter(const std::string& filename, int N, float dt, float box_w,
+                                   float box_h, float radius, uint64_t seed, bool append)
+    : filename_(filename), offset_(0) {
+    std::memset(&header_, 0, sizeof(header_));
+    std::memcpy(header_.magic, "PBTRAJ1", 8);
+    header_.version = trajectory::VERSION;
+    header_.header_bytes = sizeof(TrajectoryHeader);
+    header_.N = static_cast<uint64_t>(N);
+    header_.dt = dt;
+    header_.box_w = box_w;
+    header_.box_h = box_h;
+    header_.radius = radius;
+    header_.endian = trajectory::ENDIAN_TAG;
+    header_.seed = seed;
+    header_.frame_bytes = trajectory::frameBytes(header_.N);
+    std::strncpy(header_.schema, trajectory::SCHEMA, sizeof(header_.schema) - 1);
+
+    frame_.assign(header_.frame_bytes, 0);
+
+    if (append) {
+        file_.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+        if (file_.is_open()) {
+            file_.seekp(0, std::ios::end);
+            offset_ = static_cast<uint64_t>(file_.tellp());
+            return;
+        }
+    }
+    file_.open(filename, std::ios::binary | std::ios::out | std::ios::trunc);
+    if (!file_.is_open()) {
+        std::cerr << "Warning: Could not open trajectory file: " << filename << std::endl;
+        return;
+    }
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    offset_ = sizeof(header_);
+}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+void TrajectoryWriter::writeFrame(int step, const std::vector<Particle>& particles) {
+    if (!file_.is_open()) return;
+
+    const size_t N = header_.N;
+    char* base = frame_.data();
+    uint64_t s = static_cast<uint64_t>(step);
+    std::memcpy(base, &s, sizeof(s));
+
+    float* x = reinterpret_cast<float*>(base + sizeof(uint64_t));
+    float* y = x + N;
+    float* vx = y + N;
+    float* vy = vx + N;
+    uint8_t* bits = reinterpret_cast<uint8_t*>(vy + N);
+    std::memset(bits, 0, (N + 7) / 8);
+
+    size_t count = std::min(N, particles.size());
+    for (size_t i = 0; i < count; ++i) {
+        const auto& p = particles[i];
+        x[i] = p.x;
+        y[i] = p.y;
+        vx[i] = p.vx;
+        vy[i] = p.vy;
+        if (p.collided) {
+            bits[i >> 3] |= static_cast<uint8_t>(1u << (i & 7));
+        }
+    }
+
+    file_.write(base, frame_.size());
+    frameOffsets_.push_back(offset_);
+    offset_ += frame_.size();
+}
+
+void TrajectoryWriter::close() {
+    if (!file_.is_open()) return;
+
+    header_.frame_count = frameOffsets_.size();
+    header_.index_offset = offset_;
+    file_.write(reinterpret_cast<const char*>(frameOffsets_.data()),
+                frameOffsets_.size() * sizeof(uint64_t));
+
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    file_.close();
+}
+
+std::string TrajectoryWriter::saveState() {
+    if (file_.is_open()) {
+        file_.flush();
+    }
+    uint64_t frames = frameOffsets_.size();
+    return std::string(reinterpret_cast<const char*>(&frames), sizeof(frames));
+}
+
+bool TrajectoryWriter::restoreState(const std::string& state) {
+    if (!file_.is_open() || state.size() != sizeof(uint64_t)) return false;
+    uint64_t frames;
+    std::memcpy(&frames, state.data(), sizeof(frames));
+
+    // Frames are fixed-size, so the index can be rebuilt from the count alone
+    file_.close();
+    offset_ = header_.header_bytes + frames * header_.frame_bytes;
+    if (::truncate(filename_.c_str(), static_cast<off_t>(offset_)) != 0) {
+        std::cerr << "Warning: Could not truncate trajectory file: " << filename_ << std::endl;
+        return false;
+    }
+    file_.open(filename_, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file_.is_open()) return false;
+    // An earlier clean close left an index that no longer matches the frames:
+    // mark the file unfinished until the next close()
+    header_.frame_count = 0;
+    header_.index_offset = 0;
+    file_.seekp(0);
+    file_.write(reinterpret_cast<const char*>(&header_), sizeof(header_));
+    file_.seekp(static_cast<std::streamoff>(offset_));
+
+    frameOffsets_.clear();
+    for (uint64_t k = 0; k < frames; ++k) {
+        frameOffsets_.push_back(header_.header_bytes + k * header_.frame_bytes);
+    }
+    return true;
+}
+
+TrajectoryReader::TrajectoryReader(const std::string& filename)
+    : data_(nullptr), size_(0), frameCount_(0), index_(nullptr) {
+    std::memset(&header_, 0, sizeof(header_));
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Warning: Could not open trajectory file: " << filename << std::endl;
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TrajectoryHeader)) {
+        std::cerr << "Warning: Trajectory file too small: " << filename << std::endl;
+        ::close(fd);
+        return;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Warning: Could not map trajectory file: " << filename << std::endl;
+        size_ = 0;
+        return;
+    }
+    data_ = static_cast<const unsigned char*>(mapped);
+    std::memcpy(&header_, data_, sizeof(header_));
+
+    auto reject = [&](const char* what) {
+        std::cerr << "Error: " << what << ": " << filename << std::endl;
+        munmap(const_cast<unsigned char*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+        frameCount_ = 0;
+        index_ = nullptr;
+    };
+
+    if (std::memcmp(header_.magic, "PBTRAJ1", 8) != 0 ||
+        header_.endian != trajectory::ENDIAN_TAG) {
+        reject("Not a particle-box trajectory file");
+        return;
+    }
+    // Bound N first so frameBytes cannot overflow
+    if (header_.N > (uint64_t(1) << 56) || header_.frame_bytes != trajectory::frameBytes(header_.N) ||
+        header_.header_bytes < sizeof(TrajectoryHeader) || header_.header_bytes > size_ ||
+        header_.header_bytes % 8 != 0) {
+        reject("Corrupt trajectory header");
+        return;
+    }
+
+    if (header_.frame_count > 0) {
+        // Index and every offset in it must lie inside the file, aligned, past the header
+        if (header_.index_offset % 8 != 0 || header_.index_offset > size_ ||
+            header_.frame_count > (size_ - header_.index_offset) / sizeof(uint64_t)) {
+            reject("Corrupt trajectory frame index");
+            return;
+        }
+        const uint64_t* index = reinterpret_cast<const uint64_t*>(data_ + header_.index_offset);
+        for (uint64_t k = 0; k < header_.frame_count; ++k) {
+            if (index[k] < header_.header_bytes || index[k] % 8 != 0 ||
+                header_.frame_bytes > size_ || index[k] > size_ - header_.frame_bytes) {
+                reject("Corrupt trajectory frame index");
+                return;
+            }
+        }
+        frameCount_ = header_.frame_count;
+        index_ = index;
+    } else if (header_.frame_bytes > 0) {
+        // Writer did not finish: recover the complete frames that made it to disk
+        frameCount_ = (size_ - header_.header_bytes) / header_.frame_bytes;
+    }
+}
+
+TrajectoryReader::~TrajectoryReader() {
+    if (data_) {
+        munmap(const_cast<unsigned char*>(data_), size_);
+    }
+}
+
+TrajectoryFrame TrajectoryReader::frame(uint64_t k) const {
+    TrajectoryFrame f;
+    if (!data_ || k >= frameCount_) return f;
+
+    uint64_t offset = index_ ? index_[k] : header_.header_bytes + k * header_.frame_bytes;
+    const unsigned char* base = data_ + offset;
+    const size_t N = header_.N;
+
+    std::memcpy(&f.step, base, sizeof(uint64_t));
+    f.x = reinterpret_cast<const float*>(base + sizeof(uint64_t));
+    f.y = f.x + N;
+    f.vx = f.y + N;
+    f.vy = f.vx + N;
+    f.collided = reinterpret_cast<const uint8_t*>(f.vy + N);
+    return f;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "particle.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary columnar trajectory file (steps.bin)
+//
+// Layout (little-endian):
+//   [TrajectoryHeader]                          fixed 256 bytes
+//   [frame 0] [frame 1] ... [frame F-1]         fixed frame_bytes each
+//   [uint64 offset x F]                         frame index, at index_offset
+//
+// Frame layout:
+//   uint64 step
+//   float32 x[N], y[N], vx[N], vy[N]
+//   uint8 collided[ceil(N/8)]                   bit i = particle i collided
+//   zero padding up to a multiple of 8 bytes
+//
+// frame_count and index_offset are patched into the header on close(), so a
+// file that was not closed cleanly has frame_count == 0; its frames can still
+// be recovered from header_bytes + k * frame_bytes.
+
+struct TrajectoryHeader {
+    char magic[8];             // "PBTRAJ1\0"
+    uint32_t version;
+    uint32_t header_bytes;     // offset of the first frame
+    uint64_t N;
+    double dt;
+    float box_w, box_h;
+    float radius;
+    uint32_t endian;           // 0x01020304 as written by the producer
+    uint64_t seed;
+    uint64_t frame_count;
+    uint64_t frame_bytes;
+    uint64_t index_offset;
+    char schema[96];
+    char reserved[80];
+};
+
+static_assert(sizeof(TrajectoryHeader) == 256, "TrajectoryHeader must stay 256 bytes");
+
+namespace trajectory {
+    constexpr uint32_t VERSION = 1;
+    constexpr uint32_t ENDIAN_TAG = 0x01020304u;
+    constexpr const char* SCHEMA = "step:u64;x:f32[N];y:f32[N];vx:f32[N];vy:f32[N];collided:bit[N]";
+
+    inline uint64_t frameBytes(uint64_t N) {
+        uint64_t bytes = sizeof(uint64_t) + 4 * N * sizeof(float) + (N + 7) / 8;
+        return (bytes + 7) & ~uint64_t(7);
+    }
+}
+
+class TrajectoryWriter {
+public:
+    // append = true keeps an existing file for restoreState() instead of truncating it
+    TrajectoryWriter(const std::string& filename, int N, float dt, float box_w, float box_h,
+                     float radius, uint64_t seed, bool append = false);
+    ~TrajectoryWriter();
+
+    void writeFrame(int step, const std::vector<Particle>& particles);
+    void close();  // Writes the frame index and patches the header
+    bool isOpen() const { return file_.is_open(); }
+    size_t memoryBytes() const { return frame_.capacity() + frameOffsets_.capacity() * sizeof(uint64_t); }
+    uint64_t frameCount() const { return frameOffsets_.size(); }
+    
+    // Checkpoint support: frames written so far / drop frames written after that point
+    std::string saveState();
+    bool restoreState(const std::string& state);
+
+private:
+    std::string filename_;
+    std::fstream file_;
+    TrajectoryHeader header_;
+    std::vector<char> frame_;
+    std::vector<uint64_t> frameOffsets_;
+    uint64_t offset_;
+};
+
+// Read-only view of one frame inside a mapped trajectory file
+struct TrajectoryFrame {
+    uint64_t step = 0;
+    const float* x = nullptr;
+    const float* y = nullptr;
+    const float* vx = nullptr;
+    const float* vy = nullptr;
+    const uint8_t* collided = nullptr;
+
+    bool isCollided(size_t i) const { return (collided[i >> 3] >> (i & 7)) & 1u; }
+};
+
+// Memory-maps a steps.bin file for random access to frames
+class TrajectoryReader {
+public:
+    explicit TrajectoryReader(const std::string& filename);
+    ~TrajectoryReader();
+
+    TrajectoryReader(const TrajectoryReader&) = delete;
+    TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+    bool isOpen() const { return data_ != nullptr; }
+    const TrajectoryHeader& header() const { return header_; }
+    uint64_t frameCount() const { return frameCount_; }
+    TrajectoryFrame frame(uint64_t k) const;
+
+private:
+    TrajectoryHeader header_;
+    const unsigned char* data_;
+    size_t size_;
+    uint64_t frameCount_;
+    const uint64_t* index_;
+};